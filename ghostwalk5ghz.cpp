@@ -7,6 +7,13 @@
  * UPDATE: Fixed "No Detection" bug by removing strict DS check. Added Frame Subtype whitelist to eliminate beacons/probes.
  */
 
+// Host soak build (host/soak.cpp): runs as a headless C5 on a virtual clock
+// with stubbed WiFi, FreeRTOS and heap
+#if defined(GHOSTWALK_HOST_SOAK)
+    #define CONFIG_IDF_TARGET_ESP32C5
+    #include "host/ghostwalk_host.h"
+#endif
+
 #ifndef HSPI_HOST
   #define HSPI_HOST SPI2_HOST
 #endif
@@ -22,6 +29,7 @@
   #endif
 #endif
 
+#if !defined(GHOSTWALK_HOST_SOAK)
 #include <WiFi.h>
 #include <esp_wifi.h>
 #include <esp_system.h>
@@ -29,6 +37,10 @@
 #if __has_include(<esp_mac.h>)
     #include <esp_mac.h>
 #endif
+#if __has_include(<esp_random.h>)
+    #include <esp_random.h>
+#endif
+#endif
 #include <vector>
 #include <deque>
 #include <algorithm>
@@ -70,7 +82,10 @@
   #include <SPI.h>
 #endif
 
+#if !defined(GHOSTWALK_HOST_SOAK)
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#endif
 // --- HARDWARE DETECTION ---
 #if defined(CONFIG_IDF_TARGET_ESP32C5)
     #define HARDWARE_IS_C5 true
@@ -88,6 +103,99 @@
 #define ENABLE_BEACON_EMULATION true
 #define ENABLE_INTERACTION_SIM true   
 
+// --- ENTROPY SOURCE ---
+// false: bulk fill from the hardware RNG (esp_fill_random).
+// true: xorshift keystream from ENTROPY_SEED, for reproducible bench runs.
+#define ENABLE_DETERMINISTIC_ENTROPY false
+const uint32_t ENTROPY_SEED = 0x6A09E667;
+
+// --- CRASH TRACE (RTC SLOW MEMORY) ---
+// Compact event ring that survives watchdog/brownout/panic resets and is
+// dumped over Serial at the next boot. 8 bytes per event, no heap use.
+#define ENABLE_RTC_TRACE true
+const int RTC_TRACE_CAPACITY = 512;     // Timeline ring, must be a power of two
+const int RTC_MILESTONE_CAPACITY = 64;  // Rare events only, must be a power of two
+const int TRACE_HOP_EVERY = 8;          // One HOP record per N channel hops
+
+// --- HEAP SOAK MONITOR ---
+// Tracks free heap / largest free block per window after warm-up and flags
+// steady-state drift (String churn and meshCache fragmentation over hours).
+// Each window ends with a "[SOAK] PASS" or "[SOAK] FAIL" line. Off on
+// production units; the host soak build (host/soak.cpp) runs it over 72+
+// hours of virtual time in minutes and exits non-zero on FAIL.
+#if defined(GHOSTWALK_HOST_SOAK)
+    #define ENABLE_HEAP_SOAK_MONITOR true
+#else
+    #define ENABLE_HEAP_SOAK_MONITOR false
+#endif
+const unsigned long SOAK_SAMPLE_MS = 1000;
+const unsigned long SOAK_WARMUP_MS = 600000;     // 10 minutes before baseline
+const unsigned long SOAK_WINDOW_MS = 3600000;    // 1 hour per window
+const uint32_t SOAK_DRIFT_LIMIT_BYTES = 8192;    // Allowed drop of window minimum vs baseline
+
+// --- BATTERY / POWER PROFILES ---
+// Off by default: most boards have no divider on an ADC pin, and a floating
+// input would read as an empty cell and throttle the unit.
+// The sense pin must be set for the board: on the CYD, GPIO34 is the light
+// sensor (LDR); GPIO35 on the P3 header is a free ADC1 input.
+#define ENABLE_BATTERY_MONITOR false
+#define BATTERY_ADC_PIN -1                       // ADC1 pin behind the divider
+#if ENABLE_BATTERY_MONITOR && BATTERY_ADC_PIN < 0
+    #error "ENABLE_BATTERY_MONITOR needs BATTERY_ADC_PIN set to the divider's ADC1 pin"
+#endif
+const int BATTERY_DIVIDER_RATIO_X100 = 200;      // 2:1 divider (100k/100k)
+const unsigned long BATTERY_SAMPLE_MS = 5000;
+const int BATTERY_HYSTERESIS_PCT = 5;            // Extra charge needed to step back up a profile
+
+// --- THERMAL GOVERNOR ---
+// Uses the on-die temperature sensor (C5/S3). Classic ESP32 has no usable
+// sensor, so the governor stays at THERMAL_NORMAL there.
+#if defined(CONFIG_IDF_TARGET_ESP32C5) || defined(CONFIG_IDF_TARGET_ESP32S3)
+    #define HAS_TEMP_SENSOR true
+#else
+    #define HAS_TEMP_SENSOR false
+#endif
+#define ENABLE_THERMAL_GOVERNOR true
+const unsigned long THERMAL_SAMPLE_MS = 2000;
+const float THERMAL_HYSTERESIS_C = 5.0;          // Cool-down needed to step back
+
+// --- METRICS HISTORY ---
+// Fixed-size rings: 1 s resolution for 5 minutes, 1 min resolution for 24 hours
+// (~14 KB static). Dumped over Serial as CSV.
+#define ENABLE_METRICS_HISTORY true
+const int METRICS_SEC_SLOTS = 300;
+const int METRICS_MIN_SLOTS = 1440;
+
+// --- SPARKLINE PANEL (CYD / Standard ESP32 only) ---
+// History graphs in the free column right of the text stats, drawn into a
+// sprite and pushed with DMA from a low-priority task pinned off the loop core.
+#define ENABLE_SPARKLINE_PANEL true
+const int SPARK_X = 241;
+const int SPARK_Y = 40;
+const int SPARK_W = 76;             // One pixel per 1 s sample
+const int SPARK_H = 48;
+const int SPARK_GAP = 2;
+const unsigned long SPARKLINE_REFRESH_MS = 1000;
+const int SPARKLINE_TASK_PRIORITY = 1;  // Below the WiFi task, never above loop()
+const int SPARKLINE_TASK_CORE = 0;      // loop() runs on core 1
+
+// --- SERIAL CONSOLE ---
+// Line-oriented command shell, polled from loop(); type "help" for commands.
+#define ENABLE_SERIAL_CONSOLE true
+const int CONSOLE_RX_RING_SIZE = 256;   // Must be a power of two
+const int CONSOLE_LINE_MAX = 64;
+const int CONSOLE_MAX_BYTES_PER_POLL = 32;
+const int CONSOLE_DUMP_LINES_PER_POLL = 8;  // metrics/trace output is spread over passes
+const int CONSOLE_DUMP_MIN_TX_ROOM = 48;    // Only print a line if the UART TX can take it
+
+// --- STALL DETECTOR ---
+// Per-task heartbeats. A task that misses its expected period is logged with
+// the phase that consumed the most time (stats, console "stalls", RTC trace).
+#define ENABLE_STALL_DETECTOR true
+const unsigned long LOOP_STALL_THRESHOLD_MS = 650;  // Hop + interaction burst + stats print; the
+                                                    // mesh listen window is added from tunables
+const unsigned long TASK_STALL_SLACK_MS = 500;      // Added to a task's own sleep period
+
 // --- MESH RELAY CONFIGURATION (DYNAMIC INTERVALS) ---
 #define ENABLE_MESH_RELAY true // Master switch for mesh functionality
 #define MESH_CHANNEL 1 
@@ -100,12 +208,39 @@ const unsigned long MESH_CHECK_DURATION_MS = 100;
 // Chance to rebroadcast a cached mesh packet during a Ghost Walk TX slot
 const int MESH_RELAY_CHANCE = 5; 
 
+// Driver-level promiscuous filtering. The driver filters by frame type only,
+// so subtype (beacon/probe) and Protected-bit checks stay in the callbacks.
+// Against the driver default (everything but MISC) the scan mask drops CTRL
+// and DATA, the mesh mask only CTRL. MISC (MIMO etc.) carries no payload and
+// must never be enabled. Default for the "promisc_filter" console tunable.
+#define ENABLE_DRIVER_PROMISC_FILTER true
+const uint32_t DEFAULT_PROMISC_FILTER = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_CTRL | WIFI_PROMIS_FILTER_MASK_DATA;
+const uint32_t SCAN_PROMISC_FILTER = WIFI_PROMIS_FILTER_MASK_MGMT;
+const uint32_t MESH_PROMISC_FILTER = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA;
+
 // NEW: Decay Timer Configuration
 // Mesh data is considered fresh for 10 minutes after detection.
 const unsigned long MESH_DECAY_TIMEOUT_MS = 600000; // 10 minutes (600,000ms)
 
 // NEW: Queue and Sender Tracking
 const int MAX_MESH_QUEUE_SIZE = 40; // Practical due to dynamic sizing
+
+// Compressed at-rest mesh cache (boards without PSRAM). The cache is then
+// bounded by heap bytes (stored payload + entry overhead): the budget is what
+// the uncompressed cache held in practice, MAX_MESH_QUEUE_SIZE typical frames.
+// Frames that compress well buy more entries, up to the hard entry cap that
+// also bounds the per-frame duplicate scan.
+#if defined(BOARD_HAS_PSRAM)
+    #define ENABLE_MESH_COMPRESSION false
+#else
+    #define ENABLE_MESH_COMPRESSION true
+#endif
+const int MESH_FRAME_TYPICAL_BYTES = 290;        // Typical ESP-NOW frame as received
+const int MAX_MESH_QUEUE_SIZE_COMPRESSED = MAX_MESH_QUEUE_SIZE * 2;
+
+// FreeRTOS queue depths between the sniffer callbacks and loop()
+const int SSID_QUEUE_LENGTH = 20;
+const int MESH_RX_QUEUE_LENGTH = 5;
 const unsigned long SENDER_TRACK_WINDOW_MS = 300000; // 5 Minutes
 
 // --- POOL SETTINGS ---
@@ -178,6 +313,8 @@ const int NUM_OUI_GENERIC = 8;
 
 // --- GLOBALS ---
 TFT_eSPI tft = TFT_eSPI();
+SemaphoreHandle_t tftMutex = NULL; // Shared by updateDisplayStats and the sparkline task
+uint32_t displayBufferBytes = 0;   // Sprite memory held by the sparkline panel
 QueueHandle_t ssidQueue;
 
 // Mesh Queue and State
@@ -191,7 +328,9 @@ uint8_t localMac[6];
 
 // NEW: Queue Structures
 struct CachedMessage {
-    std::vector<uint8_t> payload;
+    std::vector<uint8_t> payload;   // Raw frame, or LZ stream when isCompressed
+    uint16_t rawLen;
+    bool isCompressed;
     unsigned long lastSeen;
 };
 
@@ -203,6 +342,19 @@ struct MeshSender {
 std::deque<CachedMessage> meshCache;
 std::vector<MeshSender> recentSenders;
 
+const size_t MESH_CACHE_BYTE_BUDGET = MAX_MESH_QUEUE_SIZE * (MESH_FRAME_TYPICAL_BYTES + sizeof(CachedMessage));
+
+// Heap held by one cache entry
+inline size_t meshEntryBytes(const CachedMessage& msg) {
+    return sizeof(CachedMessage) + msg.payload.capacity();
+}
+
+size_t meshCacheBytes() {
+    size_t total = 0;
+    for (const auto& msg : meshCache) total += meshEntryBytes(msg);
+    return total;
+}
+
 struct SniffedSSID {
     char ssid[33];
 };
@@ -217,6 +369,8 @@ bool is5GHzBand = false;
 int idx2G = 0; 
 int idx5G = 0;
 bool nextHopIs5G = true; 
+int hopsSinceTrace = 0;          // Hops aggregated into the next TRACE_HOP record
+uint32_t packetsSinceTrace = 0;
 
 unsigned long lastChannelHop = 0;
 unsigned long lastLifecycleRun = 0;
@@ -224,13 +378,7 @@ unsigned long lastUiUpdateTime = 0;
 unsigned long startTime = 0;
 unsigned long lastSsidLearnTime = 0; 
 
-unsigned long totalPacketCount = 0;
-unsigned long learnedDataCount = 0;
-unsigned long interactionCount = 0; 
-unsigned long junkPacketCount = 0;
-unsigned long sniffedPacketCount = 0;
 unsigned long activeTimeTotal = 0; 
-unsigned long meshRelayCount = 0; 
 
 // New Time Tracking for Radio Usage Split
 unsigned long meshRadioTime = 0;
@@ -238,13 +386,397 @@ unsigned long ghostRadioTime = 0;
 
 String lastLearnedSSID = "None";
 
-unsigned long packets2G = 0;
-unsigned long packets5G = 0;
+// --- STATS COUNTERS (PER-CONTEXT, LOCK-FREE) ---
+// The sniffer callbacks run in the WiFi task (core 0) while loop() runs on
+// its own task, so each context owns a private slot of 32-bit counters and is
+// the only writer to it. Readers fold the per-slot deltas into 64-bit totals,
+// which never wrap and never need a lock on the increment path.
+enum StatCounter {
+    STAT_TOTAL_PACKETS,
+    STAT_LEARNED_SSIDS,
+    STAT_INTERACTIONS,
+    STAT_JUNK_PACKETS,
+    STAT_SNIFFED_PACKETS,
+    STAT_MESH_RELAYS,
+    STAT_PACKETS_2G,
+    STAT_PACKETS_5G,
+    STAT_THERMAL_THROTTLES,
+    STAT_MESH_CALLBACKS,        // meshSnifferCallback invocations
+    STAT_MESH_FRAMES_QUEUED,    // Frames that passed the software filter
+    STAT_MESH_CALLBACK_US,      // Time spent inside meshSnifferCallback
+    NUM_STAT_COUNTERS
+};
+
+enum StatContext {
+    CTX_LOOP,   // Arduino loop task
+    CTX_WIFI,   // Promiscuous RX callbacks
+    NUM_STAT_CONTEXTS
+};
+
+struct StatSlot {
+    volatile uint32_t count[NUM_STAT_COUNTERS];
+};
+
+StatSlot statSlots[NUM_STAT_CONTEXTS];
+uint32_t statLastSeen[NUM_STAT_CONTEXTS][NUM_STAT_COUNTERS];
+uint64_t statTotals[NUM_STAT_COUNTERS];
+
+// Single-writer increment: an aligned 32-bit store is atomic on Xtensa/RISC-V
+inline void IRAM_ATTR statInc(StatContext ctx, StatCounter id) {
+    statSlots[ctx].count[id] = statSlots[ctx].count[id] + 1;
+}
+
+inline void IRAM_ATTR statAdd(StatContext ctx, StatCounter id, uint32_t n) {
+    statSlots[ctx].count[id] = statSlots[ctx].count[id] + n;
+}
+
+// Aggregated read. Only call from loop() (single reader); the 32-bit delta
+// stays exact as long as each slot is read at least once per 2^32 increments.
+uint64_t statRead(StatCounter id) {
+    for (int ctx = 0; ctx < NUM_STAT_CONTEXTS; ctx++) {
+        uint32_t now = statSlots[ctx].count[id];
+        statTotals[id] += (uint32_t)(now - statLastSeen[ctx][id]);
+        statLastSeen[ctx][id] = now;
+    }
+    return statTotals[id];
+}
+
+inline void statIncBand(bool fiveGhz) {
+    statInc(CTX_LOOP, fiveGhz ? STAT_PACKETS_5G : STAT_PACKETS_2G);
+}
+
+// --- RTC EVENT TRACE ---
+enum TraceEvent : uint8_t {
+    TRACE_BOOT,         // arg8 = reset reason
+    TRACE_HOP,          // arg8 = channel, arg16 = packets over the last TRACE_HOP_EVERY hops
+    TRACE_LIFECYCLE,    // arg8 = rotate count, arg16 = active pool size
+    TRACE_MEM_LOW,      // arg16 = free heap (KB)
+    TRACE_MEM_OK,       // arg16 = free heap (KB)
+    TRACE_MESH_CHECK,   // arg8 = mesh detected, arg16 = cache size
+    TRACE_MESH_DECAY,   // arg16 = cache size before clear
+    TRACE_HEAP_DRIFT,   // arg8 = window index, arg16 = drift (KB)
+    TRACE_POWER,        // arg8 = profile index, arg16 = battery (mV)
+    TRACE_THERMAL,      // arg8 = thermal step, arg16 = temperature (C)
+    TRACE_STALL,        // arg8 = task * 16 + phase, arg16 = stall (ms; watched tasks: gap at detection)
+    TRACE_STALL_END,    // arg8 = task * 16 + phase, arg16 = total stall of a watched task (ms)
+    NUM_TRACE_EVENTS
+};
+
+const char* TRACE_EVENT_NAMES[NUM_TRACE_EVENTS] = {
+    "BOOT", "HOP", "LIFECYCLE", "MEM_LOW", "MEM_OK", "MESH_CHECK", "MESH_DECAY", "HEAP_DRIFT",
+    "POWER", "THERMAL", "STALL", "STALL_END"
+};
+
+struct TraceRecord {
+    uint32_t ms;
+    uint8_t event;
+    uint8_t arg8;
+    uint16_t arg16;
+};
+
+// Milestones (memory, drift, power, thermal, stalls, boot) are also copied
+// into their own ring so routine hop/mesh records cannot push them out.
+struct RtcTrace {
+    uint32_t magic;
+    uint32_t head;      // Monotonic write index (wraps via mask)
+    uint32_t milestoneHead;
+    uint32_t bootCount;
+    TraceRecord records[RTC_TRACE_CAPACITY];
+    TraceRecord milestones[RTC_MILESTONE_CAPACITY];
+};
+
+const uint32_t RTC_TRACE_MAGIC = 0x47575452; // "GWTR"
+
+// Not zeroed on reset; validated by magic at boot
+RTC_NOINIT_ATTR RtcTrace rtcTrace;
+
+inline bool isTraceMilestone(TraceEvent ev) {
+    return ev != TRACE_HOP && ev != TRACE_LIFECYCLE && ev != TRACE_MESH_CHECK && ev != TRACE_MESH_DECAY;
+}
+
+inline void trace(TraceEvent ev, uint8_t arg8 = 0, uint16_t arg16 = 0) {
+    if (!ENABLE_RTC_TRACE) return;
+    TraceRecord& r = rtcTrace.records[rtcTrace.head & (RTC_TRACE_CAPACITY - 1)];
+    r.ms = millis();
+    r.event = ev;
+    r.arg8 = arg8;
+    r.arg16 = arg16;
+    rtcTrace.head++;
+
+    if (isTraceMilestone(ev)) {
+        rtcTrace.milestones[rtcTrace.milestoneHead & (RTC_MILESTONE_CAPACITY - 1)] = r;
+        rtcTrace.milestoneHead++;
+    }
+}
+
+const char* resetReasonName(esp_reset_reason_t reason) {
+    switch (reason) {
+        case ESP_RST_POWERON:   return "POWERON";
+        case ESP_RST_EXT:       return "EXTERNAL";
+        case ESP_RST_SW:        return "SOFTWARE";
+        case ESP_RST_PANIC:     return "PANIC";
+        case ESP_RST_INT_WDT:   return "INT_WDT";
+        case ESP_RST_TASK_WDT:  return "TASK_WDT";
+        case ESP_RST_WDT:       return "WDT";
+        case ESP_RST_DEEPSLEEP: return "DEEPSLEEP";
+        case ESP_RST_BROWNOUT:  return "BROWNOUT";
+        case ESP_RST_SDIO:      return "SDIO";
+        default:                return "UNKNOWN";
+    }
+}
+
+void printTraceRecord(const TraceRecord& r) {
+    const char* name = (r.event < NUM_TRACE_EVENTS) ? TRACE_EVENT_NAMES[r.event] : "?";
+    Serial.printf("%10lu %-10s %3u %5u\n", (unsigned long)r.ms, name, r.arg8, r.arg16);
+}
+
+void dumpRtcTraceRecords() {
+    uint32_t mCount = (rtcTrace.milestoneHead < RTC_MILESTONE_CAPACITY) ? rtcTrace.milestoneHead : RTC_MILESTONE_CAPACITY;
+    Serial.printf("-- milestones (%lu) --\n", (unsigned long)mCount);
+    for (uint32_t i = rtcTrace.milestoneHead - mCount; i != rtcTrace.milestoneHead; i++) {
+        printTraceRecord(rtcTrace.milestones[i & (RTC_MILESTONE_CAPACITY - 1)]);
+    }
+
+    uint32_t count = (rtcTrace.head < RTC_TRACE_CAPACITY) ? rtcTrace.head : RTC_TRACE_CAPACITY;
+    Serial.printf("-- timeline (%lu) --\n", (unsigned long)count);
+    for (uint32_t i = rtcTrace.head - count; i != rtcTrace.head; i++) {
+        printTraceRecord(rtcTrace.records[i & (RTC_TRACE_CAPACITY - 1)]);
+    }
+    Serial.println("--- [END TRACE] ---");
+}
+
+// Dump the previous session's trace (if any) and start a fresh one
+void initRtcTrace() {
+    if (!ENABLE_RTC_TRACE) return;
+    esp_reset_reason_t reason = esp_reset_reason();
+
+    // RTC contents are undefined after power-on; only trust a valid header
+    bool valid = (rtcTrace.magic == RTC_TRACE_MAGIC) && (reason != ESP_RST_POWERON);
+
+    if (valid && rtcTrace.head > 0) {
+        uint32_t count = (rtcTrace.head < RTC_TRACE_CAPACITY) ? rtcTrace.head : RTC_TRACE_CAPACITY;
+        Serial.printf("\n--- [RTC TRACE] boot #%lu, reset: %s, %lu events ---\n",
+                      (unsigned long)rtcTrace.bootCount, resetReasonName(reason), (unsigned long)count);
+        dumpRtcTraceRecords();
+    }
+
+    rtcTrace.bootCount = valid ? rtcTrace.bootCount + 1 : 0;
+    rtcTrace.magic = RTC_TRACE_MAGIC;
+    rtcTrace.head = 0;
+    rtcTrace.milestoneHead = 0;
+    trace(TRACE_BOOT, (uint8_t)reason);
+}
 
 int nextChannelHopInterval = 250;
 int nextLifecycleInterval = 3500;
 bool lowMemoryMode = false;
 
+// --- MEMORY ACCOUNTING ---
+// Approximate heap held per subsystem, with high-water marks and growth over
+// a rolling window. The device pools hold the block initSwarm reserve()s from
+// boot; how much of it is filled is tracked separately as live bytes.
+enum MemSubsystem {
+    MEM_ACTIVE_POOL,
+    MEM_DORMANT_POOL,
+    MEM_SSID_TABLE,
+    MEM_MESH_CACHE,
+    MEM_SENDER_TABLE,
+    MEM_QUEUES,
+    MEM_DISPLAY,
+    NUM_MEM_SUBSYSTEMS
+};
+
+const char* MEM_SUBSYSTEM_NAMES[NUM_MEM_SUBSYSTEMS] = {
+    "active", "dormant", "ssids", "mesh", "senders", "queues", "display"
+};
+
+struct MemAccount {
+    uint32_t bytes;             // Heap held
+    uint32_t liveBytes;         // Part of it in use (differs only for reserved pools)
+    uint32_t highWater;
+    uint32_t windowBaseline;    // bytes at the start of the growth window
+};
+
+const unsigned long MEM_GROWTH_WINDOW_MS = 60000;
+MemAccount memAccounts[NUM_MEM_SUBSYSTEMS];
+unsigned long memWindowStart = 0;
+
+// --- LIVE TUNABLES ---
+// Runtime copies of the timing constants, adjustable from the serial console.
+struct Tunables {
+    unsigned long minChannelHopMs;
+    unsigned long maxChannelHopMs;
+    unsigned long meshActiveIntervalMs;
+    unsigned long meshStandbyIntervalMs;
+    unsigned long meshCheckDurationMs;
+    unsigned long uiRefreshMs;          // 0 = follow the power profile
+    unsigned long promiscFilter;        // 1 = driver type filters, 0 = driver default
+};
+
+Tunables tunables = {
+    MIN_CHANNEL_HOP_MS, MAX_CHANNEL_HOP_MS,
+    MESH_ACTIVE_INTERVAL_MS, MESH_STANDBY_INTERVAL_MS, MESH_CHECK_DURATION_MS,
+    0, ENABLE_DRIVER_PROMISC_FILTER ? 1UL : 0UL
+};
+
+// Loop latency histogram: bucket i counts passes under 2^i ms, last is overflow
+const int LATENCY_BUCKETS = 13;
+uint32_t loopLatencyHist[LATENCY_BUCKETS];
+
+// --- HEAP SOAK STATE ---
+struct HeapSoak {
+    unsigned long lastSample;
+    unsigned long windowStart;
+    uint32_t windowIndex;
+    uint32_t windowMinFree;
+    uint32_t windowMinBlock;
+    uint32_t baselineFree;      // 0 until the first post-warm-up window closes
+    uint32_t baselineBlock;
+    uint32_t lowMemTransitions;
+    bool drifting;
+};
+
+HeapSoak heapSoak = {0, 0, 0, UINT32_MAX, UINT32_MAX, 0, 0, 0, false};
+
+// --- POWER PROFILES ---
+// Ordered from most to least charge. Scales are percentages of the nominal
+// timing constants, so PROFILE_FULL leaves behaviour unchanged.
+struct PowerProfile {
+    const char* name;
+    int minBatteryPct;          // Profile applies at or above this charge
+    int hopDwellScalePct;       // Channel hop interval
+    int burstDutyScalePct;      // Packets per hop
+    int meshIntervalScalePct;   // Mesh listen interval
+    uint8_t backlight;          // TFT backlight (0-255)
+    unsigned long uiRefreshMs;  // updateDisplayStats cadence
+};
+
+const PowerProfile POWER_PROFILES[] = {
+    {"FULL",     30, 100, 100, 100, 255, 2000},
+    {"SAVER",    15, 150,  70, 200, 120, 5000},
+    {"CRITICAL",  0, 250,  40, 400,  40, 10000}
+};
+const int NUM_POWER_PROFILES = 3;
+
+// LiPo open-circuit curve (mV -> %), linearly interpolated
+const uint16_t BATTERY_CURVE_MV[] = {3300, 3500, 3600, 3700, 3750, 3800, 3900, 4000, 4100, 4200};
+const uint8_t BATTERY_CURVE_PCT[] = {   0,    5,   10,   20,   30,   40,   60,   75,   90,  100};
+const int BATTERY_CURVE_POINTS = 10;
+
+// --- THERMAL STEPS ---
+// Ordered coolest to hottest. dutyScalePct trims packets per hop and the
+// on-air share of every noise fill; txPowerCap clamps all TX power writes.
+struct ThermalStep {
+    const char* name;
+    float minTempC;
+    int dutyScalePct;
+    int8_t txPowerCap;
+};
+
+const ThermalStep THERMAL_STEPS[] = {
+    {"NORMAL",    -40.0, 100, 82},
+    {"WARM",       65.0,  75, 78},
+    {"HOT",        75.0,  50, 74},
+    {"CRITICAL",   85.0,  25, 68}
+};
+const int NUM_THERMAL_STEPS = 4;
+
+int thermalStepIdx = 0;
+float chipTempC = 0;
+unsigned long lastThermalSample = 0;
+
+int powerProfileIdx = 0;
+int batteryPct = 100;
+uint32_t batteryMv = 0;      // Smoothed; 0 until first sample
+unsigned long lastBatterySample = 0;
+
+// --- METRICS HISTORY STATE ---
+struct MetricSample {
+    uint16_t heapKb;        // Minimum free heap seen by loop() over the interval
+    uint8_t dutyPct;        // Active radio time share
+    uint8_t thermalStep;
+    uint16_t relays;        // Mesh relays in the interval
+    uint16_t loopMaxMs;     // Slowest loop() pass in the interval
+};
+
+struct MetricRing {
+    MetricSample* samples;
+    uint16_t capacity;
+    uint16_t head;          // Next write slot
+    uint16_t count;
+    uint32_t pushed;        // Total samples ever pushed (sequence of the next one)
+};
+
+MetricSample metricsSecBuf[METRICS_SEC_SLOTS];
+MetricSample metricsMinBuf[METRICS_MIN_SLOTS];
+MetricRing metricsSec = {metricsSecBuf, METRICS_SEC_SLOTS, 0, 0, 0};
+MetricRing metricsMin = {metricsMinBuf, METRICS_MIN_SLOTS, 0, 0, 0};
+
+// Per-second accumulator
+unsigned long lastMetricsSample = 0;
+unsigned long lastMetricsActiveTime = 0;
+uint64_t lastMetricsRelays = 0;
+uint32_t metricsLoopMaxMs = 0;
+uint32_t metricsHeapMin = UINT32_MAX;   // Lowest free heap sampled since the last sample
+
+// Per-minute downsampling accumulator (min heap, mean duty, sum relays, max latency)
+MetricSample metricsMinAccum;
+uint32_t metricsMinDutySum = 0;
+uint32_t metricsMinRelaySum = 0;
+uint8_t metricsMinSamples = 0;
+
+// --- TASK HEARTBEATS ---
+enum TaskPhase : uint8_t {
+    PHASE_IDLE,
+    PHASE_CONSOLE,
+    PHASE_SSID_INGEST,
+    PHASE_RESOURCES,
+    PHASE_LIFECYCLE,
+    PHASE_MESH_CHECK,
+    PHASE_HOP_TX,
+    PHASE_NOISE,
+    PHASE_DISPLAY,
+    PHASE_SPARKLINE,
+    NUM_TASK_PHASES
+};
+
+const char* TASK_PHASE_NAMES[NUM_TASK_PHASES] = {
+    "idle", "console", "ssid_ingest", "resources", "lifecycle",
+    "mesh_check", "hop_tx", "noise", "display", "sparkline"
+};
+
+enum MonitoredTask {
+    TASK_LOOP,
+    TASK_SPARKLINE,
+    NUM_MONITORED_TASKS
+};
+
+struct TaskHeartbeat {
+    const char* name;
+    volatile unsigned long expectedPeriodMs;
+    volatile unsigned long lastBeat;        // 0 = task not started
+    volatile uint8_t phase;
+
+    // Written by the owning task
+    unsigned long phaseStart;
+    uint32_t passPhaseMs[NUM_TASK_PHASES];  // Time per phase in the current pass
+    volatile uint8_t lastPassPhase;         // Dominant phase of the previous pass
+
+    // Written by loop() only
+    bool watchStalled;
+    unsigned long watchStallStart;
+    uint8_t watchStallPhase;
+    uint32_t stallCount;
+    unsigned long worstStallMs;
+    uint8_t worstStallPhase;
+    uint32_t phaseStalls[NUM_TASK_PHASES];
+};
+
+TaskHeartbeat heartbeats[NUM_MONITORED_TASKS] = {
+    {"loop", LOOP_STALL_THRESHOLD_MS},
+    {"sparkline", SPARKLINE_REFRESH_MS + TASK_STALL_SLACK_MS}
+};
+
 // --- DATA POOLS ---
 const char* SEED_SSIDS[] = {
   "xfinitywifi", "Starbucks WiFi", "attwifi", "Google Starbucks", 
@@ -291,6 +823,29 @@ const uint8_t RATES_5G[] = {0x0c, 0x12, 0x18, 0x24, 0x30, 0x48, 0x60, 0x6c};
 
 // --- FUNCTION IMPLEMENTATIONS ---
 
+// --- BULK ENTROPY PROVIDER ---
+// Fills a whole buffer in one pass instead of one random(256) call per byte.
+// The hardware path reads 32 bits of RNG per 4 output bytes.
+uint32_t entropyState = ENTROPY_SEED;
+
+void fillEntropy(uint8_t* buf, size_t len) {
+#if ENABLE_DETERMINISTIC_ENTROPY
+    size_t i = 0;
+    while (i < len) {
+        entropyState ^= entropyState << 13;
+        entropyState ^= entropyState >> 17;
+        entropyState ^= entropyState << 5;
+        uint32_t word = entropyState;
+        for (int b = 0; b < 4 && i < len; b++, i++) {
+            buf[i] = word & 0xFF;
+            word >>= 8;
+        }
+    }
+#else
+    esp_fill_random(buf, len);
+#endif
+}
+
 int addTag(uint8_t* buf, int ptr, uint8_t id, const uint8_t* data, int len) {
     buf[ptr++] = id;
     buf[ptr++] = len;
@@ -298,36 +853,557 @@ int addTag(uint8_t* buf, int ptr, uint8_t id, const uint8_t* data, int len) {
     return ptr + len;
 }
 
+// --- MEMORY ACCOUNTING ---
+void updateMemAccounting(unsigned long currentMillis) {
+    uint32_t bytes[NUM_MEM_SUBSYSTEMS];
+    bytes[MEM_ACTIVE_POOL] = activeSwarm.capacity() * sizeof(VirtualDevice);
+    bytes[MEM_DORMANT_POOL] = dormantSwarm.capacity() * sizeof(VirtualDevice);
+
+    bytes[MEM_SSID_TABLE] = activeSSIDs.capacity() * sizeof(String);
+    for (const auto& ssid : activeSSIDs) bytes[MEM_SSID_TABLE] += ssid.length() + 1;
+
+    bytes[MEM_MESH_CACHE] = meshCacheBytes();
+
+    bytes[MEM_SENDER_TABLE] = recentSenders.capacity() * sizeof(MeshSender);
+    bytes[MEM_QUEUES] = SSID_QUEUE_LENGTH * sizeof(SniffedSSID) +
+                        (ENABLE_MESH_RELAY ? MESH_RX_QUEUE_LENGTH * sizeof(MeshPacket) : 0);
+    bytes[MEM_DISPLAY] = displayBufferBytes;
+
+    bool newWindow = (memWindowStart == 0 || currentMillis - memWindowStart >= MEM_GROWTH_WINDOW_MS);
+    if (newWindow) memWindowStart = currentMillis;
+
+    for (int i = 0; i < NUM_MEM_SUBSYSTEMS; i++) {
+        MemAccount& a = memAccounts[i];
+        a.bytes = bytes[i];
+        a.liveBytes = bytes[i];
+        if (a.bytes > a.highWater) a.highWater = a.bytes;
+        if (newWindow) a.windowBaseline = a.bytes;
+    }
+    memAccounts[MEM_ACTIVE_POOL].liveBytes = activeSwarm.size() * sizeof(VirtualDevice);
+    memAccounts[MEM_DORMANT_POOL].liveBytes = dormantSwarm.size() * sizeof(VirtualDevice);
+}
+
+int32_t memGrowth(int subsystem) {
+    return (int32_t)memAccounts[subsystem].bytes - (int32_t)memAccounts[subsystem].windowBaseline;
+}
+
+// Drop the oldest entries of a pool. The capacity is deliberately kept:
+// shrinking would undo initSwarm's reserve() and force a ~2x reallocation
+// (old block still live) on the next push_back once memory recovers.
+template <typename T>
+void dropFront(std::vector<T>& v, size_t dropCount) {
+    if (dropCount == 0) return;
+    v.erase(v.begin(), v.begin() + dropCount);
+}
+
+// Picks one subsystem to shed per pass. Only the mesh cache and the learned
+// SSIDs give heap back when trimmed, so they are ranked first: the
+// fastest-growing wins, equal growth goes to the one holding more bytes, and
+// a full tie to list order. The device pools live in blocks reserved at boot;
+// trimming them frees no heap, so they are a last resort when nothing else
+// can be trimmed. The active pool and learned SSIDs wait for critically low.
+void relieveMemoryPressure(uint32_t freeHeap) {
+    updateMemAccounting(millis());
+    bool critical = (freeHeap < 15000);
+
+    const int candidates[] = {MEM_MESH_CACHE, MEM_SSID_TABLE};
+    int target = -1;
+    int32_t bestGrowth = 0;
+    uint32_t bestBytes = 0;
+    for (int c : candidates) {
+        bool reclaimable = (c == MEM_MESH_CACHE) ? !meshCache.empty()
+                                                 : critical && activeSSIDs.size() > NUM_SEED_SSIDS;
+        if (!reclaimable) continue;
+
+        int32_t growth = memGrowth(c) > 0 ? memGrowth(c) : 0;
+        if (target < 0 || growth > bestGrowth || (growth == bestGrowth && memAccounts[c].bytes > bestBytes)) {
+            target = c;
+            bestGrowth = growth;
+            bestBytes = memAccounts[c].bytes;
+        }
+    }
+    if (target < 0) {
+        if (!dormantSwarm.empty()) target = MEM_DORMANT_POOL;
+        else if (critical && !activeSwarm.empty()) target = MEM_ACTIVE_POOL;
+    }
+
+    switch (target) {
+        case MEM_DORMANT_POOL:
+            // Drop 30% of dormant (frees no heap; see above)
+            dropFront(dormantSwarm, dormantSwarm.size() * 0.30);
+            break;
+        case MEM_MESH_CACHE: {
+            // Oldest quarter of the cache (at least one message)
+            size_t dropCount = meshCache.size() / 4 + 1;
+            while (dropCount-- > 0 && !meshCache.empty()) meshCache.pop_front();
+            break;
+        }
+        case MEM_SSID_TABLE: {
+            // 10% of learned SSIDs; seeds stay
+            size_t learned = activeSSIDs.size() - NUM_SEED_SSIDS;
+            size_t dropCount = learned / 10 + 1;
+            activeSSIDs.erase(activeSSIDs.begin() + NUM_SEED_SSIDS, activeSSIDs.begin() + NUM_SEED_SSIDS + dropCount);
+            break;
+        }
+        case MEM_ACTIVE_POOL:
+            dropFront(activeSwarm, activeSwarm.size() * 0.15);
+            break;
+        default:
+            break;
+    }
+}
+
 // --- RESOURCE MANAGEMENT ---
 void manageResources() {
     uint32_t freeHeap = ESP.getFreeHeap();
     
     // Aggressive Cleanup Threshold
     if (freeHeap < 25000) {
+        if (!lowMemoryMode) {
+            trace(TRACE_MEM_LOW, 0, freeHeap / 1024);
+            heapSoak.lowMemTransitions++;
+        }
         lowMemoryMode = true;
         
-        // 1. Drop Dormant Swarm first (Least valuable)
-        if (!dormantSwarm.empty()) {
-            // Drop 30% of dormant to free contiguous blocks
-            int dropCount = dormantSwarm.size() * 0.30;
-            if (dropCount > 0) {
-                dormantSwarm.erase(dormantSwarm.begin(), dormantSwarm.begin() + dropCount);
-            }
+        // Shed the largest growing consumer (see relieveMemoryPressure)
+        relieveMemoryPressure(freeHeap);
+    } else {
+        if (lowMemoryMode) trace(TRACE_MEM_OK, 0, freeHeap / 1024);
+        lowMemoryMode = false;
+    }
+}
+
+// Samples heap once per second; at the end of each window, logs one CSV
+// line and compares the window minimum against the post-warm-up baseline.
+void updateHeapSoak(unsigned long currentMillis) {
+    if (!ENABLE_HEAP_SOAK_MONITOR) return;
+    if (currentMillis < SOAK_WARMUP_MS) return;
+    if (currentMillis - heapSoak.lastSample < SOAK_SAMPLE_MS) return;
+    heapSoak.lastSample = currentMillis;
+    if (heapSoak.windowStart == 0) heapSoak.windowStart = currentMillis;
+
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t maxBlock = ESP.getMaxAllocHeap();
+    if (freeHeap < heapSoak.windowMinFree) heapSoak.windowMinFree = freeHeap;
+    if (maxBlock < heapSoak.windowMinBlock) heapSoak.windowMinBlock = maxBlock;
+
+    if (currentMillis - heapSoak.windowStart < SOAK_WINDOW_MS) return;
+
+    int fragPct = (heapSoak.windowMinFree > 0) ?
+                  100 - (int)((uint64_t)heapSoak.windowMinBlock * 100 / heapSoak.windowMinFree) : 0;
+
+    // CSV: window,min_free,min_block,frag%,active,dormant,ssids,cache,lowmem_transitions
+    Serial.printf("[SOAK] %lu,%lu,%lu,%d,%d,%d,%d,%d,%lu\n",
+                  (unsigned long)heapSoak.windowIndex,
+                  (unsigned long)heapSoak.windowMinFree, (unsigned long)heapSoak.windowMinBlock, fragPct,
+                  activeSwarm.size(), dormantSwarm.size(), activeSSIDs.size(), meshCache.size(),
+                  (unsigned long)heapSoak.lowMemTransitions);
+
+    if (heapSoak.baselineFree == 0) {
+        heapSoak.baselineFree = heapSoak.windowMinFree;
+        heapSoak.baselineBlock = heapSoak.windowMinBlock;
+    } else {
+        uint32_t freeDrift = (heapSoak.baselineFree > heapSoak.windowMinFree) ?
+                             heapSoak.baselineFree - heapSoak.windowMinFree : 0;
+        uint32_t blockDrift = (heapSoak.baselineBlock > heapSoak.windowMinBlock) ?
+                              heapSoak.baselineBlock - heapSoak.windowMinBlock : 0;
+        uint32_t drift = (freeDrift > blockDrift) ? freeDrift : blockDrift;
+        if (drift > SOAK_DRIFT_LIMIT_BYTES) {
+            if (!heapSoak.drifting) trace(TRACE_HEAP_DRIFT, heapSoak.windowIndex, drift / 1024);
+            heapSoak.drifting = true;
         }
-        
-        // 2. If still critically low, prune Active Swarm
-        if (freeHeap < 15000 && !activeSwarm.empty()) {
-            int dropCount = activeSwarm.size() * 0.15;
-            if (dropCount > 0) {
-                 activeSwarm.erase(activeSwarm.begin(), activeSwarm.begin() + dropCount);
-            }
-            // Also stop learning new SSIDs in critical mode
+        // Drift latches: once failed, the soak stays failed until reboot
+        Serial.printf("[SOAK] %s window %lu: -%lu bytes vs baseline (limit %lu)\n",
+                      heapSoak.drifting ? "FAIL" : "PASS", (unsigned long)heapSoak.windowIndex,
+                      (unsigned long)drift, (unsigned long)SOAK_DRIFT_LIMIT_BYTES);
+    }
+
+    heapSoak.windowIndex++;
+    heapSoak.windowStart = currentMillis;
+    heapSoak.windowMinFree = UINT32_MAX;
+    heapSoak.windowMinBlock = UINT32_MAX;
+}
+
+// --- STALL DETECTOR ---
+// Switches the running phase of a task and returns the previous one, so
+// nested sections (e.g. noise fills inside a hop) can restore it.
+uint8_t enterPhase(MonitoredTask t, uint8_t phase) {
+    TaskHeartbeat& hb = heartbeats[t];
+    unsigned long now = millis();
+    hb.passPhaseMs[hb.phase] += now - hb.phaseStart;
+    uint8_t previous = hb.phase;
+    hb.phase = phase;
+    hb.phaseStart = now;
+    return previous;
+}
+
+// Marks the start of a task pass. Returns the gap since the previous beat.
+unsigned long heartbeat(MonitoredTask t) {
+    TaskHeartbeat& hb = heartbeats[t];
+    enterPhase(t, PHASE_IDLE);
+
+    uint8_t dominant = PHASE_IDLE;
+    for (int i = 0; i < NUM_TASK_PHASES; i++) {
+        if (hb.passPhaseMs[i] > hb.passPhaseMs[dominant]) dominant = i;
+        hb.passPhaseMs[i] = 0;
+    }
+    hb.lastPassPhase = dominant;
+
+    unsigned long now = millis();
+    unsigned long gap = (hb.lastBeat == 0) ? 0 : now - hb.lastBeat;
+    hb.lastBeat = now;
+    return gap;
+}
+
+void updateWorstStall(TaskHeartbeat& hb, unsigned long stallMs, uint8_t phase) {
+    if (stallMs > hb.worstStallMs) {
+        hb.worstStallMs = stallMs;
+        hb.worstStallPhase = phase;
+    }
+}
+
+void recordStall(MonitoredTask t, unsigned long stallMs, uint8_t phase) {
+    TaskHeartbeat& hb = heartbeats[t];
+    hb.stallCount++;
+    hb.phaseStalls[phase]++;
+    updateWorstStall(hb, stallMs, phase);
+    trace(TRACE_STALL, t * 16 + phase, stallMs > 0xFFFF ? 0xFFFF : stallMs);
+}
+
+// Runs from loop(). The loop task is judged by its own beat gap; other tasks
+// are watched live: a stall is counted and traced as soon as the task is
+// overdue (so a deadlocked task still shows up), and its length keeps
+// growing in the stats until the task beats again.
+void checkHeartbeats(unsigned long loopGap) {
+    if (!ENABLE_STALL_DETECTOR) return;
+    if (loopGap > heartbeats[TASK_LOOP].expectedPeriodMs) {
+        recordStall(TASK_LOOP, loopGap, heartbeats[TASK_LOOP].lastPassPhase);
+    }
+
+    for (int t = TASK_LOOP + 1; t < NUM_MONITORED_TASKS; t++) {
+        TaskHeartbeat& hb = heartbeats[t];
+        // Read the beat before the clock: the task may beat on the other
+        // core in between, which must not look like a huge gap
+        unsigned long lastBeat = hb.lastBeat;
+        if (lastBeat == 0) continue;
+        long sinceBeat = (long)(millis() - lastBeat);
+
+        bool overdue = (sinceBeat > (long)hb.expectedPeriodMs);
+        if (overdue && !hb.watchStalled) {
+            hb.watchStalled = true;
+            hb.watchStallStart = lastBeat;
+            hb.watchStallPhase = hb.phase;
+            recordStall((MonitoredTask)t, sinceBeat, hb.watchStallPhase);
+        } else if (overdue) {
+            updateWorstStall(hb, sinceBeat, hb.watchStallPhase);
+        } else if (hb.watchStalled) {
+            hb.watchStalled = false;
+            unsigned long stallMs = lastBeat - hb.watchStallStart;
+            updateWorstStall(hb, stallMs, hb.watchStallPhase);
+            trace(TRACE_STALL_END, t * 16 + hb.watchStallPhase, stallMs > 0xFFFF ? 0xFFFF : stallMs);
         }
+    }
+}
+
+// --- BATTERY MONITOR ---
+int batteryPercentFromMv(uint32_t mv) {
+    if (mv <= BATTERY_CURVE_MV[0]) return 0;
+    for (int i = 1; i < BATTERY_CURVE_POINTS; i++) {
+        if (mv < BATTERY_CURVE_MV[i]) {
+            int spanMv = BATTERY_CURVE_MV[i] - BATTERY_CURVE_MV[i-1];
+            int spanPct = BATTERY_CURVE_PCT[i] - BATTERY_CURVE_PCT[i-1];
+            return BATTERY_CURVE_PCT[i-1] + (int)(mv - BATTERY_CURVE_MV[i-1]) * spanPct / spanMv;
+        }
+    }
+    return 100;
+}
+
+const PowerProfile& activePowerProfile() {
+    return POWER_PROFILES[powerProfileIdx];
+}
+
+void applyPowerProfile(int idx) {
+    if (idx == powerProfileIdx) return;
+    powerProfileIdx = idx;
+    trace(TRACE_POWER, idx, batteryMv);
+    Serial.printf("[POWER] Profile -> %s (%lu mV, %d%%)\n",
+                  POWER_PROFILES[idx].name, (unsigned long)batteryMv, batteryPct);
+#if defined(TFT_BL)
+    if (!HARDWARE_IS_C5) analogWrite(TFT_BL, POWER_PROFILES[idx].backlight);
+#endif
+}
+
+void updateBattery(unsigned long currentMillis) {
+    if (!ENABLE_BATTERY_MONITOR) return;
+    if (batteryMv != 0 && currentMillis - lastBatterySample < BATTERY_SAMPLE_MS) return;
+    lastBatterySample = currentMillis;
+
+    uint32_t mv = analogReadMilliVolts(BATTERY_ADC_PIN) * BATTERY_DIVIDER_RATIO_X100 / 100;
+    // Smooth TX load sag: 1/4 weight per sample
+    batteryMv = (batteryMv == 0) ? mv : (batteryMv * 3 + mv) / 4;
+    batteryPct = batteryPercentFromMv(batteryMv);
+
+    // Step down immediately; step back up one profile at a time, each only
+    // with hysteresis above that profile's threshold
+    int target = NUM_POWER_PROFILES - 1;
+    for (int i = 0; i < NUM_POWER_PROFILES; i++) {
+        if (batteryPct >= POWER_PROFILES[i].minBatteryPct) { target = i; break; }
+    }
+    if (target < powerProfileIdx) {
+        int next = powerProfileIdx - 1;
+        target = (batteryPct >= POWER_PROFILES[next].minBatteryPct + BATTERY_HYSTERESIS_PCT) ? next : powerProfileIdx;
+    }
+    applyPowerProfile(target);
+}
+
+// --- THERMAL GOVERNOR ---
+const ThermalStep& activeThermalStep() {
+    return THERMAL_STEPS[thermalStepIdx];
+}
+
+// All TX power changes go through here so the thermal cap always applies
+void setTxPower(int8_t power) {
+    int8_t cap = activeThermalStep().txPowerCap;
+    esp_wifi_set_max_tx_power(power > cap ? cap : power);
+}
+
+void updateThermalGovernor(unsigned long currentMillis) {
+    if (!ENABLE_THERMAL_GOVERNOR || !HAS_TEMP_SENSOR) return;
+    if (currentMillis - lastThermalSample < THERMAL_SAMPLE_MS) return;
+    lastThermalSample = currentMillis;
+
+    chipTempC = temperatureRead();
+
+    // Step up as soon as a threshold is crossed; step down only after cooling
+    int target = 0;
+    for (int i = NUM_THERMAL_STEPS - 1; i > 0; i--) {
+        if (chipTempC >= THERMAL_STEPS[i].minTempC) { target = i; break; }
+    }
+    if (target < thermalStepIdx &&
+        chipTempC > THERMAL_STEPS[thermalStepIdx].minTempC - THERMAL_HYSTERESIS_C) {
+        target = thermalStepIdx;
+    }
+    if (target == thermalStepIdx) return;
+
+    if (target > thermalStepIdx) statInc(CTX_LOOP, STAT_THERMAL_THROTTLES);
+    thermalStepIdx = target;
+    trace(TRACE_THERMAL, target, (uint16_t)chipTempC);
+    Serial.printf("[THERMAL] %0.1fC -> %s (duty %d%%, cap %d)\n", chipTempC,
+                  THERMAL_STEPS[target].name, THERMAL_STEPS[target].dutyScalePct, THERMAL_STEPS[target].txPowerCap);
+}
+
+// --- METRICS HISTORY ---
+void pushMetric(MetricRing& ring, const MetricSample& sample) {
+    ring.samples[ring.head] = sample;
+    ring.head = (ring.head + 1) % ring.capacity;
+    if (ring.count < ring.capacity) ring.count++;
+    ring.pushed++;
+}
+
+// i = 0 is the oldest retained sample
+const MetricSample& metricAt(const MetricRing& ring, int i) {
+    int start = (ring.head + ring.capacity - ring.count) % ring.capacity;
+    return ring.samples[(start + i) % ring.capacity];
+}
+
+void recordLoopLatency(unsigned long loopMs) {
+    if (loopMs > metricsLoopMaxMs) metricsLoopMaxMs = loopMs;
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && loopMs >= (1UL << bucket)) bucket++;
+    loopLatencyHist[bucket]++;
+}
+
+void updateMetricsHistory(unsigned long currentMillis) {
+    if (!ENABLE_METRICS_HISTORY) return;
+
+    // Sampled every pass so short dips between one-second samples are kept
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < metricsHeapMin) metricsHeapMin = freeHeap;
+
+    unsigned long elapsed = currentMillis - lastMetricsSample;
+    if (elapsed < 1000) return;
+    lastMetricsSample = currentMillis;
+
+    uint64_t relays = statRead(STAT_MESH_RELAYS);
+    unsigned long activeDelta = activeTimeTotal - lastMetricsActiveTime;
+    lastMetricsActiveTime = activeTimeTotal;
+
+    updateMemAccounting(currentMillis);
+
+    MetricSample s;
+    s.heapKb = metricsHeapMin / 1024;
+    s.dutyPct = (activeDelta >= elapsed) ? 100 : activeDelta * 100 / elapsed;
+    s.thermalStep = thermalStepIdx;
+    s.relays = (uint16_t)(relays - lastMetricsRelays);
+    s.loopMaxMs = (metricsLoopMaxMs > 0xFFFF) ? 0xFFFF : metricsLoopMaxMs;
+    lastMetricsRelays = relays;
+    metricsLoopMaxMs = 0;
+    metricsHeapMin = UINT32_MAX;
+    pushMetric(metricsSec, s);
+
+    // Downsample 60 one-second samples into one minute sample
+    if (metricsMinSamples == 0) {
+        metricsMinAccum = s;
+        metricsMinDutySum = 0;
+        metricsMinRelaySum = 0;
+    }
+    if (s.heapKb < metricsMinAccum.heapKb) metricsMinAccum.heapKb = s.heapKb;
+    if (s.loopMaxMs > metricsMinAccum.loopMaxMs) metricsMinAccum.loopMaxMs = s.loopMaxMs;
+    if (s.thermalStep > metricsMinAccum.thermalStep) metricsMinAccum.thermalStep = s.thermalStep;
+    metricsMinDutySum += s.dutyPct;
+    metricsMinRelaySum += s.relays;
+    if (++metricsMinSamples >= 60) {
+        metricsMinAccum.dutyPct = metricsMinDutySum / metricsMinSamples;
+        metricsMinAccum.relays = (metricsMinRelaySum > 0xFFFF) ? 0xFFFF : metricsMinRelaySum;
+        pushMetric(metricsMin, metricsMinAccum);
+        metricsMinSamples = 0;
+    }
+}
+
+// --- MESH CACHE COMPRESSION ---
+// Byte-oriented LZ77 (LZ4-style tokens, no external library):
+//   0x00-0x7F: literal run of (c + 1) bytes follows
+//   0x80-0xFF: match of ((c & 0x7F) + 3) bytes, then 16-bit LE back-offset
+// Frames are stored compressed and expanded into a scratch buffer right
+// before relay, so the transmitted bytes are identical to what was heard.
+const int MESH_LZ_MIN_MATCH = 3;
+const int MESH_LZ_MAX_MATCH = 0x7F + MESH_LZ_MIN_MATCH;
+const int MESH_LZ_MAX_LITERALS = 0x80;
+const int MESH_LZ_HASH_BITS = 8;
+
+uint8_t meshCompressScratch[1024 + 1024 / MESH_LZ_MAX_LITERALS + 1]; // Worst-case expansion
+uint8_t meshRelayScratch[1024];
+
+// Compression accounting (loop() only)
+uint32_t meshRawBytesTotal = 0;
+uint32_t meshStoredBytesTotal = 0;
+uint32_t meshDecompressCount = 0;
+uint32_t meshDecompressMicrosTotal = 0;
+
+inline uint8_t meshLzHash(const uint8_t* p) {
+    return (uint8_t)(((uint32_t)(p[0] << 16 | p[1] << 8 | p[2]) * 2654435761UL) >> (32 - MESH_LZ_HASH_BITS));
+}
+
+int meshLzFlushLiterals(const uint8_t* src, int from, int to, uint8_t* dst, int op, int dstCap) {
+    while (from < to) {
+        int n = to - from;
+        if (n > MESH_LZ_MAX_LITERALS) n = MESH_LZ_MAX_LITERALS;
+        if (op + 1 + n > dstCap) return -1;
+        dst[op++] = n - 1;
+        memcpy(&dst[op], &src[from], n);
+        op += n;
+        from += n;
+    }
+    return op;
+}
+
+// Returns the compressed length, or -1 if it would not fit in dstCap
+int meshCompress(const uint8_t* src, int len, uint8_t* dst, int dstCap) {
+    int16_t table[1 << MESH_LZ_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    int ip = 0, op = 0, litStart = 0;
+    while (ip + MESH_LZ_MIN_MATCH <= len) {
+        uint8_t h = meshLzHash(&src[ip]);
+        int cand = table[h];
+        table[h] = ip;
+
+        if (cand >= 0 && memcmp(&src[cand], &src[ip], MESH_LZ_MIN_MATCH) == 0) {
+            int mlen = MESH_LZ_MIN_MATCH;
+            while (ip + mlen < len && mlen < MESH_LZ_MAX_MATCH && src[cand + mlen] == src[ip + mlen]) mlen++;
+
+            op = meshLzFlushLiterals(src, litStart, ip, dst, op, dstCap);
+            if (op < 0 || op + 3 > dstCap) return -1;
+            int offset = ip - cand;
+            dst[op++] = 0x80 | (mlen - MESH_LZ_MIN_MATCH);
+            dst[op++] = offset & 0xFF;
+            dst[op++] = (offset >> 8) & 0xFF;
+            ip += mlen;
+            litStart = ip;
+        } else {
+            ip++;
+        }
+    }
+    return meshLzFlushLiterals(src, litStart, len, dst, op, dstCap);
+}
+
+// Returns the expanded length, or -1 on a malformed stream
+int meshDecompress(const uint8_t* src, int len, uint8_t* dst, int dstCap) {
+    int ip = 0, op = 0;
+    while (ip < len) {
+        uint8_t c = src[ip++];
+        if (c < 0x80) {
+            int n = c + 1;
+            if (ip + n > len || op + n > dstCap) return -1;
+            memcpy(&dst[op], &src[ip], n);
+            ip += n;
+            op += n;
+        } else {
+            int mlen = (c & 0x7F) + MESH_LZ_MIN_MATCH;
+            if (ip + 2 > len) return -1;
+            int offset = src[ip] | (src[ip + 1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > op || op + mlen > dstCap) return -1;
+            // Byte-wise copy: matches may overlap their own output
+            for (int k = 0; k < mlen; k++, op++) dst[op] = dst[op - offset];
+        }
+    }
+    return op;
+}
+
+// Evicts oldest entries until the incoming one fits: by byte budget and
+// entry cap when compressing, by entry count otherwise
+void makeRoomInMeshCache(const CachedMessage& incoming) {
+    if (!ENABLE_MESH_COMPRESSION) {
+        if (meshCache.size() >= MAX_MESH_QUEUE_SIZE) meshCache.pop_front();
+        return;
+    }
+    size_t total = meshCacheBytes();
+    while (!meshCache.empty() &&
+           (total + meshEntryBytes(incoming) > MESH_CACHE_BYTE_BUDGET ||
+            meshCache.size() >= MAX_MESH_QUEUE_SIZE_COMPRESSED)) {
+        total -= meshEntryBytes(meshCache.front());
+        meshCache.pop_front();
+    }
+}
+
+// "n/40" for the count-bounded cache, "n/80 (9K/13K)" for the byte-bounded one
+void formatMeshCacheFill(char* out, size_t n) {
+    if (ENABLE_MESH_COMPRESSION) {
+        snprintf(out, n, "%d/%d (%uK/%uK)", (int)meshCache.size(), MAX_MESH_QUEUE_SIZE_COMPRESSED,
+                 (unsigned)(meshCacheBytes() / 1024), (unsigned)(MESH_CACHE_BYTE_BUDGET / 1024));
     } else {
-        lowMemoryMode = false;
+        snprintf(out, n, "%d/%d", (int)meshCache.size(), MAX_MESH_QUEUE_SIZE);
     }
 }
 
+// Fills msg with the at-rest form of a received frame. Falls back to the raw
+// bytes when compression does not pay off.
+void storeMeshFrame(CachedMessage& msg, const uint8_t* frame, int len) {
+    msg.rawLen = len;
+    msg.isCompressed = false;
+    if (ENABLE_MESH_COMPRESSION) {
+        int clen = meshCompress(frame, len, meshCompressScratch, sizeof(meshCompressScratch));
+        if (clen > 0 && clen < len) {
+            msg.payload.assign(meshCompressScratch, meshCompressScratch + clen);
+            msg.isCompressed = true;
+            return;
+        }
+    }
+    msg.payload.assign(frame, frame + len);
+}
+
+// Returns a pointer to the byte-identical original frame (decompressing into
+// the relay scratch buffer if needed), or NULL if the stream is corrupt.
+const uint8_t* loadMeshFrame(const CachedMessage& msg) {
+    if (!msg.isCompressed) return msg.payload.data();
+    unsigned long t0 = micros();
+    int len = meshDecompress(msg.payload.data(), msg.payload.size(), meshRelayScratch, sizeof(meshRelayScratch));
+    meshDecompressMicrosTotal += micros() - t0;
+    meshDecompressCount++;
+    return (len == msg.rawLen) ? meshRelayScratch : NULL;
+}
+
 void manageMeshResources(unsigned long currentMillis) {
     // 1. Prune Timed-out Senders (5 Minute Window)
     auto senderIt = recentSenders.begin();
@@ -357,7 +1433,7 @@ void IRAM_ATTR snifferCallback(void* buf, wifi_promiscuous_pkt_type_t type) {
     wifi_promiscuous_pkt_t* pkt = (wifi_promiscuous_pkt_t*)buf;
     uint8_t* frame = pkt->payload;
 
-    sniffedPacketCount++; // Track Monitor Activity
+    statInc(CTX_WIFI, STAT_SNIFFED_PACKETS); // Track Monitor Activity
     
     if (frame[0] != 0x40) return; // Only Probe Requests
     
@@ -374,10 +1450,9 @@ void IRAM_ATTR snifferCallback(void* buf, wifi_promiscuous_pkt_type_t type) {
 }
 
 // --- MESH SNIFFER (UPDATED - NOISE FILTERING) ---
-void IRAM_ATTR meshSnifferCallback(void* buf, wifi_promiscuous_pkt_type_t type) {
-    if (!ENABLE_MESH_RELAY) return;
-    // 1. Broad Acceptance: Allow Data, Misc, and Management
-    if (type != WIFI_PKT_DATA && type != WIFI_PKT_MISC && type != WIFI_PKT_MGMT) return;
+void IRAM_ATTR meshSnifferFilter(void* buf, wifi_promiscuous_pkt_type_t type) {
+    // 1. Broad Acceptance: Allow Data and Management (MISC frames have no payload)
+    if (type != WIFI_PKT_DATA && type != WIFI_PKT_MGMT) return;
 
     wifi_promiscuous_pkt_t* pkt = (wifi_promiscuous_pkt_t*)buf;
     uint8_t* frame = pkt->payload;
@@ -406,10 +1481,22 @@ void IRAM_ATTR meshSnifferCallback(void* buf, wifi_promiscuous_pkt_type_t type)
     if (len <= 1024) {
         memcpy(mp.payload, frame, len);
         mp.len = len;
-        xQueueSendFromISR(meshQueue, &mp, NULL); 
+        if (xQueueSendFromISR(meshQueue, &mp, NULL) == pdTRUE) {
+            statInc(CTX_WIFI, STAT_MESH_FRAMES_QUEUED);
+        }
     }
 }
 
+// Counts and times every delivery, so the cost of frames the driver filter
+// lets through shows up in the mesh window stats
+void IRAM_ATTR meshSnifferCallback(void* buf, wifi_promiscuous_pkt_type_t type) {
+    if (!ENABLE_MESH_RELAY) return;
+    unsigned long t0 = micros();
+    statInc(CTX_WIFI, STAT_MESH_CALLBACKS);
+    meshSnifferFilter(buf, type);
+    statAdd(CTX_WIFI, STAT_MESH_CALLBACK_US, micros() - t0);
+}
+
 // --- STRICT IDENTITY GENERATOR ---
 void generateWeightedIdentity(VirtualDevice& vd) {
     int roll = random(100); 
@@ -455,17 +1542,21 @@ void generateWeightedIdentity(VirtualDevice& vd) {
     bool usePrivate = (gen == GEN_MODERN && random(100) < 85) ||
                       (gen == GEN_COMMON && random(100) < 50);
     
+    // One bulk fill covers the whole MAC plus the random half of the BSSID
+    uint8_t addrEntropy[9];
+    fillEntropy(addrEntropy, sizeof(addrEntropy));
+
     if (usePrivate) {
-        vd.mac[0] = (random(256) & 0xFE) | 0x02; 
-        vd.mac[1] = random(256); vd.mac[2] = random(256);
+        vd.mac[0] = (addrEntropy[0] & 0xFE) | 0x02; 
+        vd.mac[1] = addrEntropy[1]; vd.mac[2] = addrEntropy[2];
     } else {
         vd.mac[0] = selectedOUI[0]; vd.mac[1] = selectedOUI[1]; vd.mac[2] = selectedOUI[2];
     }
-    vd.mac[3] = random(256); vd.mac[4] = random(256); vd.mac[5] = random(256);
+    memcpy(&vd.mac[3], &addrEntropy[3], 3);
     
     // Target AP MAC (randomized but sticky)
     vd.bssid_target[0] = 0x00; vd.bssid_target[1] = 0x11; vd.bssid_target[2] = 0x32;
-    vd.bssid_target[3] = random(256); vd.bssid_target[4] = random(256); vd.bssid_target[5] = random(256);
+    memcpy(&vd.bssid_target[3], &addrEntropy[6], 3);
     
     vd.sequenceNumber = random(4096);
     
@@ -528,18 +1619,21 @@ void processLifecycle() {
 
 // --- NOISE GENERATOR ---
 void fillSilenceWithNoise(unsigned long durationMs) {
+    uint8_t outerPhase = enterPhase(TASK_LOOP, PHASE_NOISE);
     unsigned long start = millis();
     // Noise power floor
     int noisePower = 68 + random(0, 6); 
-    esp_wifi_set_max_tx_power(noisePower); 
+    setTxPower(noisePower); 
+
+    // Thermal throttling: transmit for part of the slot, idle for the rest
+    unsigned long txMs = durationMs * activeThermalStep().dutyScalePct / 100;
     
-    while (millis() - start < durationMs) {
+    while (millis() - start < txMs) {
         uint8_t noiseMac[6];
         
         // Uses Locally Administered Random MACs (Private) to simulate background randomization
-        noiseMac[0] = (random(256) & 0xFE) | 0x02; 
-        noiseMac[1] = random(256); noiseMac[2] = random(256);
-        noiseMac[3] = random(256); noiseMac[4] = random(256); noiseMac[5] = random(256);
+        fillEntropy(noiseMac, 6);
+        noiseMac[0] = (noiseMac[0] & 0xFE) | 0x02; 
 
         noiseBuffer[0] = 0x40; // Probe Request
         noiseBuffer[1] = 0x00; noiseBuffer[2] = 0x00; noiseBuffer[3] = 0x00;
@@ -568,10 +1662,12 @@ void fillSilenceWithNoise(unsigned long durationMs) {
         }
 
         esp_wifi_80211_tx(WIFI_IF_STA, noiseBuffer, ptr, false);
-        totalPacketCount++;
-        junkPacketCount++;
+        statInc(CTX_LOOP, STAT_TOTAL_PACKETS);
+        statInc(CTX_LOOP, STAT_JUNK_PACKETS);
         yield();
     }
+    if (txMs < durationMs) delay(durationMs - txMs);
+    enterPhase(TASK_LOOP, outerPhase);
 }
 
 // --- PACKET BUILDERS ---
@@ -635,8 +1731,8 @@ int buildEncryptedDataPacket(uint8_t* buf, VirtualDevice& vd) {
     int ptr = 24;
     buf[ptr++] = random(0, 8); buf[ptr++] = 0x00; 
     int payloadLen = random(64, 512); 
-    for(int i=0; i<payloadLen; i++) buf[ptr++] = random(0, 256);
-    return ptr;
+    fillEntropy(&buf[ptr], payloadLen);
+    return ptr + payloadLen;
 }
 
 int buildProbePacket(uint8_t* buf, VirtualDevice& vd, int channel) {
@@ -746,7 +1842,17 @@ int buildBeaconPacket(uint8_t* buf, uint8_t* mac, const String& ssid, int channe
 
 
 // --- DISPLAY (MODIFIED for dynamic mesh stats) ---
+void lockDisplay() {
+    if (tftMutex) xSemaphoreTake(tftMutex, portMAX_DELAY);
+}
+
+void unlockDisplay() {
+    if (tftMutex) xSemaphoreGive(tftMutex);
+}
+
 void updateDisplayStats(unsigned long currentMillis) {
+    lockDisplay();
+
     // --- SERIAL HEADER (Runs on ALL) ---
     Serial.println("\n--- [STATS UPDATE] ---");
 
@@ -759,6 +1865,12 @@ void updateDisplayStats(unsigned long currentMillis) {
         tft.printf("--- TRAFFIC METRICS ---"); 
     }
     Serial.println("--- TRAFFIC METRICS ---"); 
+
+    uint64_t totalPackets = statRead(STAT_TOTAL_PACKETS);
+    uint64_t junkPackets = statRead(STAT_JUNK_PACKETS);
+    uint64_t sniffedPackets = statRead(STAT_SNIFFED_PACKETS);
+    uint64_t packets2G = statRead(STAT_PACKETS_2G);
+    uint64_t packets5G = statRead(STAT_PACKETS_5G);
     
     // --- MEMORY STATS ---
     if (!HARDWARE_IS_C5) {
@@ -768,6 +1880,32 @@ void updateDisplayStats(unsigned long currentMillis) {
         tft.printf("Free RAM: %d KB %s", ESP.getFreeHeap()/1024, lowMemoryMode ? "[LOW]" : ""); 
     }
     Serial.printf("Free RAM: %d KB %s\n", ESP.getFreeHeap()/1024, lowMemoryMode ? "[LOW]" : ""); 
+    updateMemAccounting(currentMillis);
+    Serial.print("Heap use (B, peak):");
+    for (int i = 0; i < NUM_MEM_SUBSYSTEMS; i++) {
+        Serial.printf(" %s %lu(%lu)", MEM_SUBSYSTEM_NAMES[i],
+                      (unsigned long)memAccounts[i].bytes, (unsigned long)memAccounts[i].highWater);
+    }
+    Serial.println();
+    if (ENABLE_HEAP_SOAK_MONITOR) {
+        Serial.printf("Max Block: %lu KB | LowMem Trips: %lu | Drift: %s\n",
+                      (unsigned long)(ESP.getMaxAllocHeap() / 1024), (unsigned long)heapSoak.lowMemTransitions,
+                      heapSoak.drifting ? "DETECTED" : (heapSoak.baselineFree ? "OK" : "WARMUP"));
+    }
+    if (ENABLE_BATTERY_MONITOR) {
+        Serial.printf("Battery: %lu mV %d%% [%s]\n", (unsigned long)batteryMv, batteryPct, activePowerProfile().name);
+    }
+    if (ENABLE_STALL_DETECTOR) {
+        const TaskHeartbeat& lhb = heartbeats[TASK_LOOP];
+        Serial.printf("Stalls: loop %lu (worst %lums in %s) | sparkline %lu%s\n",
+                      (unsigned long)lhb.stallCount, lhb.worstStallMs, TASK_PHASE_NAMES[lhb.worstStallPhase],
+                      (unsigned long)heartbeats[TASK_SPARKLINE].stallCount,
+                      heartbeats[TASK_SPARKLINE].watchStalled ? " [STALLED]" : "");
+    }
+    if (ENABLE_THERMAL_GOVERNOR && HAS_TEMP_SENSOR) {
+        Serial.printf("Thermal: %0.1fC [%s] | Throttles: %llu\n", chipTempC, activeThermalStep().name,
+                      statRead(STAT_THERMAL_THROTTLES));
+    }
     
     // --- SWARM STATS ---
     if (!HARDWARE_IS_C5) {
@@ -781,15 +1919,15 @@ void updateDisplayStats(unsigned long currentMillis) {
     if (!HARDWARE_IS_C5) {
         tft.setTextColor(TFT_WHITE, TFT_BLACK);
         tft.setCursor(5, 89); 
-        tft.printf("Total Packets: %lu", totalPacketCount);
+        tft.printf("Total Packets: %llu", totalPackets);
         tft.setCursor(5, 101); 
-        tft.printf("Junk: %lu", junkPacketCount);
+        tft.printf("Junk: %llu", junkPackets);
     }
-    Serial.printf("Total Packets: %lu\n", totalPacketCount);
-    Serial.printf("Junk: %lu\n", junkPacketCount);
+    Serial.printf("Total Packets: %llu\n", totalPackets);
+    Serial.printf("Junk: %llu\n", junkPackets);
 
     // --- BAND CALCULATIONS ---
-    unsigned long total = packets2G + packets5G;
+    uint64_t total = packets2G + packets5G;
     int p2g = (total > 0) ? (packets2G * 100 / total) : 0;
     int p5g = (total > 0) ? (packets5G * 100 / total) : 0;
     String hwType = HARDWARE_IS_C5 ? "Dual" : "Single";
@@ -805,9 +1943,9 @@ void updateDisplayStats(unsigned long currentMillis) {
     if (!HARDWARE_IS_C5) {
         tft.setTextColor(TFT_ORANGE, TFT_BLACK);
         tft.setCursor(5, 127); 
-        tft.printf("Found SSIDs: %lu / %d", learnedDataCount, MAX_SSIDS_TO_LEARN);
+        tft.printf("Found SSIDs: %llu / %d", statRead(STAT_LEARNED_SSIDS), MAX_SSIDS_TO_LEARN);
     }
-    Serial.printf("Found SSIDs: %lu / %d\n", learnedDataCount, MAX_SSIDS_TO_LEARN);
+    Serial.printf("Found SSIDs: %llu / %d\n", statRead(STAT_LEARNED_SSIDS), MAX_SSIDS_TO_LEARN);
     
     String truncSSID = lastLearnedSSID;
     if (truncSSID.length() > 22) truncSSID = truncSSID.substring(0, 22) + "...";
@@ -837,9 +1975,9 @@ void updateDisplayStats(unsigned long currentMillis) {
     float idle = 0;
     if(runTime > 0) idle = 100.0 * (1.0 - ((float)activeTimeTotal / runTime));
     
-    unsigned long totalAct = totalPacketCount + sniffedPacketCount;
+    uint64_t totalAct = totalPackets + sniffedPackets;
     int monPct = 0;
-    if(totalAct > 0) monPct = (sniffedPacketCount * 100) / totalAct;
+    if(totalAct > 0) monPct = (sniffedPackets * 100) / totalAct;
     
     if (!HARDWARE_IS_C5) {
         tft.setTextColor(TFT_WHITE, TFT_BLACK);
@@ -875,18 +2013,20 @@ void updateDisplayStats(unsigned long currentMillis) {
     } else if(isMeshDetected) {
         unsigned long timeRemaining = (MESH_DECAY_TIMEOUT_MS > (currentMillis - lastMeshPacketTime)) 
                                     ? (MESH_DECAY_TIMEOUT_MS - (currentMillis - lastMeshPacketTime)) : 0;
+        char cacheFill[24];
+        formatMeshCacheFill(cacheFill, sizeof(cacheFill));
         
         if (!HARDWARE_IS_C5) {
             tft.setTextColor(TFT_GREEN, TFT_BLACK);
             tft.printf("MESH RELAY: ACTIVE (T-%lums)", timeRemaining);
             tft.setCursor(5, 199);
-            tft.printf("Q: %d/%d | Senders(5m): %d", meshCache.size(), MAX_MESH_QUEUE_SIZE, recentSenders.size());
+            tft.printf("Q: %s | Senders(5m): %d", cacheFill, recentSenders.size());
         }
         Serial.printf("MESH RELAY: ACTIVE (T-%lums)\n", timeRemaining);
-        Serial.printf("Q: %d/%d | Senders(5m): %d\n", meshCache.size(), MAX_MESH_QUEUE_SIZE, recentSenders.size());
+        Serial.printf("Q: %s | Senders(5m): %d\n", cacheFill, recentSenders.size());
     } else {
-        unsigned long timeRemaining = (MESH_STANDBY_INTERVAL_MS > (currentMillis - lastMeshCheckTime)) 
-                                    ? (MESH_STANDBY_INTERVAL_MS - (currentMillis - lastMeshCheckTime)) : 0;
+        unsigned long timeRemaining = (tunables.meshStandbyIntervalMs > (currentMillis - lastMeshCheckTime)) 
+                                    ? (tunables.meshStandbyIntervalMs - (currentMillis - lastMeshCheckTime)) : 0;
         
         if (!HARDWARE_IS_C5) {
             tft.setTextColor(TFT_ORANGE, TFT_BLACK);
@@ -902,12 +2042,123 @@ void updateDisplayStats(unsigned long currentMillis) {
     if (!HARDWARE_IS_C5) {
         tft.setCursor(5, 211);
         tft.setTextColor(TFT_WHITE, TFT_BLACK);
-        tft.printf("Total Relayed: %lu", meshRelayCount);
+        tft.printf("Total Relayed: %llu", statRead(STAT_MESH_RELAYS));
+        if (ENABLE_BATTERY_MONITOR) {
+            tft.setCursor(5, 223);
+            tft.setTextColor(batteryPct < 30 ? TFT_ORANGE : TFT_GREEN, TFT_BLACK);
+            tft.printf("Batt: %d%% [%s]", batteryPct, activePowerProfile().name);
+        }
+    }
+    Serial.printf("Total Relayed: %llu\n", statRead(STAT_MESH_RELAYS));
+
+    unlockDisplay();
+}
+
+// --- SPARKLINE PANEL ---
+#if !defined(CONFIG_IDF_TARGET_ESP32C5)
+enum SparkMetric {
+    SPARK_HEAP,
+    SPARK_DUTY,
+    SPARK_RELAYS,
+    SPARK_LATENCY,
+    NUM_SPARK_METRICS
+};
+
+const char* SPARK_LABELS[NUM_SPARK_METRICS] = {"HEAP KB", "DUTY %", "RELAY/s", "LOOP ms"};
+const uint16_t SPARK_COLORS[NUM_SPARK_METRICS] = {TFT_GREEN, TFT_CYAN, TFT_ORANGE, TFT_YELLOW};
+
+TFT_eSprite sparkSprite = TFT_eSprite(&tft);
+
+uint16_t sparkValue(const MetricSample& m, int metric) {
+    switch (metric) {
+        case SPARK_HEAP:    return m.heapKb;
+        case SPARK_DUTY:    return m.dutyPct;
+        case SPARK_RELAYS:  return m.relays;
+        default:            return m.loopMaxMs;
+    }
+}
+
+// Renders one graph into the sprite and DMA-pushes only that tile.
+// The metrics ring is written by loop(); a torn sample only mis-plots one pixel.
+void drawSparkline(int metric) {
+    int count = metricsSec.count;
+    int first = (count > SPARK_W) ? count - SPARK_W : 0;
+    int points = count - first;
+
+    uint16_t lo = 0xFFFF, hi = 0;
+    for (int i = first; i < count; i++) {
+        uint16_t v = sparkValue(metricAt(metricsSec, i), metric);
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    if (points == 0) { lo = 0; hi = 0; }
+    uint16_t span = (hi > lo) ? hi - lo : 1;
+    const int plotTop = 10;
+    const int plotH = SPARK_H - plotTop - 1;
+
+    sparkSprite.fillSprite(TFT_BLACK);
+    sparkSprite.drawRect(0, 0, SPARK_W, SPARK_H, TFT_DARKGREY);
+    sparkSprite.setTextColor(SPARK_COLORS[metric], TFT_BLACK);
+    sparkSprite.setCursor(2, 1);
+    sparkSprite.printf("%s %u", SPARK_LABELS[metric], points ? sparkValue(metricAt(metricsSec, count - 1), metric) : 0);
+
+    int prevY = -1;
+    for (int i = 0; i < points; i++) {
+        uint16_t v = sparkValue(metricAt(metricsSec, first + i), metric);
+        int y = plotTop + plotH - 1 - (int)(v - lo) * (plotH - 1) / span;
+        int x = SPARK_W - points + i;
+        if (prevY < 0) sparkSprite.drawPixel(x, y, SPARK_COLORS[metric]);
+        else sparkSprite.drawLine(x - 1, prevY, x, y, SPARK_COLORS[metric]);
+        prevY = y;
+    }
+
+    int tileY = SPARK_Y + metric * (SPARK_H + SPARK_GAP);
+    lockDisplay();
+    tft.startWrite();
+    tft.pushImageDMA(SPARK_X, tileY, SPARK_W, SPARK_H, (uint16_t*)sparkSprite.getPointer());
+    tft.dmaWait(); // Sprite buffer is reused for the next tile
+    tft.endWrite();
+    unlockDisplay();
+}
+
+void sparklineTask(void* param) {
+    uint16_t lastHead = 0xFFFF;
+    for (;;) {
+        heartbeat(TASK_SPARKLINE);
+
+        // Redraw only when the 1 s ring has a new sample
+        if (metricsSec.count > 0 && metricsSec.head != lastHead) {
+            enterPhase(TASK_SPARKLINE, PHASE_SPARKLINE);
+            lastHead = metricsSec.head;
+            for (int m = 0; m < NUM_SPARK_METRICS; m++) drawSparkline(m);
+            enterPhase(TASK_SPARKLINE, PHASE_IDLE);
+        }
+        unsigned long refresh = tunables.uiRefreshMs ? tunables.uiRefreshMs : activePowerProfile().uiRefreshMs;
+        if (refresh < SPARKLINE_REFRESH_MS) refresh = SPARKLINE_REFRESH_MS;
+        heartbeats[TASK_SPARKLINE].expectedPeriodMs = refresh + TASK_STALL_SLACK_MS;
+        vTaskDelay(pdMS_TO_TICKS(refresh));
     }
-    Serial.printf("Total Relayed: %lu\n", meshRelayCount);
 }
 
+void startSparklinePanel() {
+    if (!ENABLE_SPARKLINE_PANEL || !ENABLE_METRICS_HISTORY) return;
+    sparkSprite.setColorDepth(16); // pushImageDMA expects RGB565
+    if (sparkSprite.createSprite(SPARK_W, SPARK_H) == NULL) {
+        Serial.println("Sparkline: sprite alloc failed");
+        return;
+    }
+    displayBufferBytes = SPARK_W * SPARK_H * 2;
+    tft.initDMA();
+    xTaskCreatePinnedToCore(sparklineTask, "sparkline", 4096, NULL,
+                            SPARKLINE_TASK_PRIORITY, NULL, SPARKLINE_TASK_CORE);
+}
+#else
+void startSparklinePanel() {}
+#endif
+
 void setupDisplay() {
+  tftMutex = xSemaphoreCreateMutex();
+
   if (!HARDWARE_IS_C5) {
       tft.init();
       tft.setRotation(1); 
@@ -932,13 +2183,34 @@ void setupDisplay() {
   }
   
   updateDisplayStats(millis()); 
+  if (!HARDWARE_IS_C5) startSparklinePanel();
+}
+
+// Callback rate and callback CPU share (per mille of the window) of the last
+// mesh listen window; compare with "set promisc_filter 0" / "1"
+uint32_t meshWindowCallbacksPerSec = 0;
+uint32_t meshWindowQueued = 0;
+uint32_t meshWindowCpuPermille = 0;
+
+void setPromiscFilter(uint32_t mask) {
+    wifi_promiscuous_filter_t filter = {};
+    filter.filter_mask = tunables.promiscFilter ? mask : DEFAULT_PROMISC_FILTER;
+    esp_wifi_set_promiscuous_filter(&filter);
 }
 
 // --- MESH CHECK INTERRUPT ---
 void checkAndListenForMesh() {
     if (!ENABLE_MESH_RELAY) return; // Exit if disabled
 
-    // 1. Temporarily change RX callback to the mesh sniffer
+    uint64_t callbacksBefore = statRead(STAT_MESH_CALLBACKS);
+    uint64_t queuedBefore = statRead(STAT_MESH_FRAMES_QUEUED);
+    uint64_t callbackUsBefore = statRead(STAT_MESH_CALLBACK_US);
+
+    // 1. Temporarily change RX callback to the mesh sniffer and widen the
+    //    driver filter to the frame types ESP-NOW / mesh traffic can use
+    wifi_promiscuous_filter_t savedFilter = {};
+    esp_wifi_get_promiscuous_filter(&savedFilter);
+    setPromiscFilter(MESH_PROMISC_FILTER);
     esp_wifi_set_promiscuous_rx_cb(meshSnifferCallback);
     
     // 2. Switch to Mesh Channel (Channel 1)
@@ -946,7 +2218,7 @@ void checkAndListenForMesh() {
 
     unsigned long start = millis();
     // 3. Listen for a brief duration (100ms)
-    while (millis() - start < MESH_CHECK_DURATION_MS) {
+    while (millis() - start < tunables.meshCheckDurationMs) {
         MeshPacket mp;
         // Non-blocking check for a received packet
         if (xQueueReceive(meshQueue, &mp, 0) == pdTRUE) {
@@ -997,11 +2269,16 @@ void checkAndListenForMesh() {
                 }
             }
 
-            // --- QUEUE MANAGEMENT (40 Message FIFO with Refresh) ---
+            // --- QUEUE MANAGEMENT (FIFO with Refresh) ---
+            // Compression is deterministic, so duplicates compare equal in stored form
+            CachedMessage incoming;
+            storeMeshFrame(incoming, mp.payload, mp.len);
+
             bool msgKnown = false;
             for (auto& cached : meshCache) {
-                if (cached.payload.size() == mp.len && 
-                    memcmp(cached.payload.data(), mp.payload, mp.len) == 0) {
+                if (cached.rawLen == incoming.rawLen && cached.isCompressed == incoming.isCompressed &&
+                    cached.payload.size() == incoming.payload.size() &&
+                    memcmp(cached.payload.data(), incoming.payload.data(), incoming.payload.size()) == 0) {
                     // Duplicate: Reset Timeout
                     cached.lastSeen = millis();
                     msgKnown = true;
@@ -1011,14 +2288,12 @@ void checkAndListenForMesh() {
 
             if (!msgKnown) {
                 // Remove oldest if full
-                if (meshCache.size() >= MAX_MESH_QUEUE_SIZE) {
-                    meshCache.pop_front();
-                }
+                makeRoomInMeshCache(incoming);
                 
-                CachedMessage newMsg;
-                newMsg.payload.assign(mp.payload, mp.payload + mp.len);
-                newMsg.lastSeen = millis();
-                meshCache.push_back(newMsg);
+                meshRawBytesTotal += incoming.rawLen;
+                meshStoredBytesTotal += incoming.payload.size();
+                incoming.lastSeen = millis();
+                meshCache.push_back(std::move(incoming));
             }
 
             isMeshDetected = true; // Mesh is confirmed active
@@ -1033,15 +2308,340 @@ void checkAndListenForMesh() {
     
     // 4. Restore the Ghost Walk sniffer callback (for Probe Request learning)
     esp_wifi_set_promiscuous_rx_cb(snifferCallback);
+    esp_wifi_set_promiscuous_filter(&savedFilter);
+
+    uint32_t callbacks = statRead(STAT_MESH_CALLBACKS) - callbacksBefore;
+    meshWindowCallbacksPerSec = (duration > 0) ? callbacks * 1000 / duration : 0;
+    meshWindowQueued = statRead(STAT_MESH_FRAMES_QUEUED) - queuedBefore;
+    uint64_t callbackUs = statRead(STAT_MESH_CALLBACK_US) - callbackUsBefore;
+    meshWindowCpuPermille = (duration > 0) ? callbackUs / duration : 0;
+}
+
+
+// --- SERIAL CONSOLE ---
+// Bytes are drained from the UART into a ring, then assembled into a line a
+// few at a time. At most one command runs per loop() pass, and the long
+// metrics/trace dumps are printed a few lines per pass, only while the UART
+// TX has room, so the console never stalls the radio schedule.
+uint8_t consoleRing[CONSOLE_RX_RING_SIZE];
+uint16_t consoleRingHead = 0;   // Write index
+uint16_t consoleRingTail = 0;   // Read index
+char consoleLine[CONSOLE_LINE_MAX + 1];
+int consoleLineLen = 0;
+bool consoleLineOverflow = false;
+
+// Incremental dump: each stage walks one ring by absolute sequence number,
+// up to the head captured when the stage started.
+enum ConsoleDump {
+    DUMP_NONE,
+    DUMP_METRICS_SEC,
+    DUMP_METRICS_MIN,
+    DUMP_TRACE_MILESTONES,
+    DUMP_TRACE_TIMELINE
+};
+
+ConsoleDump consoleDump = DUMP_NONE;
+uint32_t consoleDumpSeq = 0;    // Next record to print
+uint32_t consoleDumpEnd = 0;    // One past the last record of this stage
+
+struct TunableDef {
+    const char* name;
+    unsigned long* value;
+    unsigned long minVal;
+    unsigned long maxVal;
+};
+
+const TunableDef TUNABLE_DEFS[] = {
+    {"hop_min",      &tunables.minChannelHopMs,       20,    5000},
+    {"hop_max",      &tunables.maxChannelHopMs,       20,    5000},
+    {"mesh_active",  &tunables.meshActiveIntervalMs,  500,   600000},
+    {"mesh_standby", &tunables.meshStandbyIntervalMs, 500,   3600000},
+    {"mesh_listen",  &tunables.meshCheckDurationMs,   10,    2000},
+    {"ui_refresh",   &tunables.uiRefreshMs,           0,     60000},
+    {"promisc_filter", &tunables.promiscFilter,       0,     1}
+};
+const int NUM_TUNABLES = sizeof(TUNABLE_DEFS) / sizeof(TUNABLE_DEFS[0]);
+
+void consolePrintTunables() {
+    for (int i = 0; i < NUM_TUNABLES; i++) {
+        Serial.printf("  %-13s %lu\n", TUNABLE_DEFS[i].name, *TUNABLE_DEFS[i].value);
+    }
+}
+
+void consoleSet(const char* name, const char* valueStr) {
+    if (!name || !valueStr) {
+        Serial.println("usage: set <name> <value>");
+        return;
+    }
+    for (int i = 0; i < NUM_TUNABLES; i++) {
+        const TunableDef& t = TUNABLE_DEFS[i];
+        if (strcmp(name, t.name) != 0) continue;
+
+        char* end;
+        unsigned long v = strtoul(valueStr, &end, 10);
+        if (*end != '\0' || v < t.minVal || v > t.maxVal) {
+            Serial.printf("%s: expected %lu..%lu\n", t.name, t.minVal, t.maxVal);
+            return;
+        }
+        unsigned long previous = *t.value;
+        *t.value = v;
+        if (tunables.minChannelHopMs >= tunables.maxChannelHopMs) {
+            *t.value = previous;
+            Serial.println("hop_min must stay below hop_max");
+            return;
+        }
+        if (t.value == &tunables.promiscFilter) setPromiscFilter(SCAN_PROMISC_FILTER);
+        Serial.printf("%s = %lu\n", t.name, v);
+        return;
+    }
+    Serial.printf("unknown tunable '%s'\n", name);
 }
 
+void consolePrintLatency() {
+    Serial.println("--- LOOP LATENCY ---");
+    uint32_t total = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) total += loopLatencyHist[i];
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        int bar = total ? (int)((uint64_t)loopLatencyHist[i] * 40 / total) : 0;
+        if (i == LATENCY_BUCKETS - 1) Serial.printf(">=%5lu ms %9lu ", 1UL << (i - 1), (unsigned long)loopLatencyHist[i]);
+        else Serial.printf(" <%5lu ms %9lu ", 1UL << i, (unsigned long)loopLatencyHist[i]);
+        for (int b = 0; b < bar; b++) Serial.print("#");
+        Serial.println();
+    }
+}
+
+void consolePrintPools() {
+    Serial.println("--- POOLS ---");
+    Serial.printf("Active: %d / %d | Dormant: %d / %d\n",
+                  activeSwarm.size(), TARGET_ACTIVE_POOL, dormantSwarm.size(), TARGET_DORMANT_POOL);
+    Serial.printf("SSIDs: %d / %d\n", activeSSIDs.size(), MAX_SSIDS_TO_LEARN + CYCLE_CAP_BUFFER);
+    char cacheFill[24];
+    formatMeshCacheFill(cacheFill, sizeof(cacheFill));
+    Serial.printf("Mesh cache: %s | Senders: %d\n", cacheFill, recentSenders.size());
+    if (ENABLE_MESH_COMPRESSION) {
+        size_t rawNow = 0, storedNow = 0;
+        for (const auto& m : meshCache) { rawNow += m.rawLen; storedNow += m.payload.size(); }
+        Serial.printf("Mesh LZ: cached %u -> %u B | lifetime ratio %lu.%02lu | decompress avg %lu us\n",
+                      rawNow, storedNow,
+                      meshStoredBytesTotal ? (unsigned long)(meshRawBytesTotal / meshStoredBytesTotal) : 0UL,
+                      meshStoredBytesTotal ? (unsigned long)((uint64_t)(meshRawBytesTotal % meshStoredBytesTotal) * 100 / meshStoredBytesTotal) : 0UL,
+                      meshDecompressCount ? (unsigned long)(meshDecompressMicrosTotal / meshDecompressCount) : 0UL);
+    }
+    Serial.printf("Mesh window: %lu cb/s, cb CPU %lu.%lu%%, %lu queued | Driver filter: %s\n",
+                  (unsigned long)meshWindowCallbacksPerSec,
+                  (unsigned long)(meshWindowCpuPermille / 10), (unsigned long)(meshWindowCpuPermille % 10),
+                  (unsigned long)meshWindowQueued, tunables.promiscFilter ? "ON" : "off");
+    Serial.printf("SSID queue: %lu | Mesh queue: %lu\n", (unsigned long)uxQueueMessagesWaiting(ssidQueue),
+                  ENABLE_MESH_RELAY ? (unsigned long)uxQueueMessagesWaiting(meshQueue) : 0UL);
+}
+
+void consolePrintMemory() {
+    Serial.println("--- MEMORY POLICY ---");
+    Serial.printf("Free: %lu | Max block: %lu | Min ever: %lu\n", (unsigned long)ESP.getFreeHeap(),
+                  (unsigned long)ESP.getMaxAllocHeap(), (unsigned long)ESP.getMinFreeHeap());
+    Serial.printf("Low memory mode: %s (enter < 25000, prune active < 15000)\n", lowMemoryMode ? "ON" : "off");
+    Serial.printf("Soak: %s | LowMem trips: %lu\n",
+                  heapSoak.drifting ? "DRIFT" : (heapSoak.baselineFree ? "OK" : "WARMUP"),
+                  (unsigned long)heapSoak.lowMemTransitions);
+    Serial.printf("Power: %s | Thermal: %s\n", activePowerProfile().name, activeThermalStep().name);
+
+    updateMemAccounting(millis());
+    Serial.println("subsystem       bytes       live      peak   growth/60s");
+    for (int i = 0; i < NUM_MEM_SUBSYSTEMS; i++) {
+        Serial.printf("%-10s %10lu %10lu %9lu %+10ld\n", MEM_SUBSYSTEM_NAMES[i],
+                      (unsigned long)memAccounts[i].bytes, (unsigned long)memAccounts[i].liveBytes,
+                      (unsigned long)memAccounts[i].highWater, (long)memGrowth(i));
+    }
+}
+
+void consolePrintStalls() {
+    Serial.println("--- STALLS ---");
+    for (int t = 0; t < NUM_MONITORED_TASKS; t++) {
+        const TaskHeartbeat& hb = heartbeats[t];
+        if (hb.lastBeat == 0) continue;
+        Serial.printf("%s: %lu stalls, worst %lums in %s (period %lums, now in %s)\n",
+                      hb.name, (unsigned long)hb.stallCount, hb.worstStallMs, TASK_PHASE_NAMES[hb.worstStallPhase],
+                      (unsigned long)hb.expectedPeriodMs, TASK_PHASE_NAMES[hb.phase]);
+        if (hb.watchStalled) {
+            Serial.printf("  STALLED for %lums in %s\n", millis() - hb.watchStallStart, TASK_PHASE_NAMES[hb.watchStallPhase]);
+        }
+        for (int p = 0; p < NUM_TASK_PHASES; p++) {
+            if (hb.phaseStalls[p]) Serial.printf("  %-12s %lu\n", TASK_PHASE_NAMES[p], (unsigned long)hb.phaseStalls[p]);
+        }
+    }
+}
+
+// Oldest sequence number still retained by the stage's ring
+uint32_t consoleDumpOldest(ConsoleDump stage) {
+    switch (stage) {
+        case DUMP_METRICS_SEC: return metricsSec.pushed - metricsSec.count;
+        case DUMP_METRICS_MIN: return metricsMin.pushed - metricsMin.count;
+        case DUMP_TRACE_MILESTONES:
+            return rtcTrace.milestoneHead - ((rtcTrace.milestoneHead < RTC_MILESTONE_CAPACITY) ? rtcTrace.milestoneHead : RTC_MILESTONE_CAPACITY);
+        case DUMP_TRACE_TIMELINE:
+            return rtcTrace.head - ((rtcTrace.head < RTC_TRACE_CAPACITY) ? rtcTrace.head : RTC_TRACE_CAPACITY);
+        default: return 0;
+    }
+}
+
+void beginConsoleDump(ConsoleDump stage) {
+    consoleDump = stage;
+    consoleDumpSeq = consoleDumpOldest(stage);
+    switch (stage) {
+        case DUMP_METRICS_SEC:
+        case DUMP_METRICS_MIN: {
+            const MetricRing& ring = (stage == DUMP_METRICS_SEC) ? metricsSec : metricsMin;
+            consoleDumpEnd = ring.pushed;
+            Serial.printf("--- [METRICS %s] %d samples, %lus step, oldest first ---\n",
+                          stage == DUMP_METRICS_SEC ? "1S" : "1M", ring.count, stage == DUMP_METRICS_SEC ? 1UL : 60UL);
+            Serial.println("age_s,heap_kb,duty_pct,relays,loop_max_ms,thermal");
+            break;
+        }
+        case DUMP_TRACE_MILESTONES:
+            consoleDumpEnd = rtcTrace.milestoneHead;
+            Serial.printf("-- milestones (%lu) --\n", (unsigned long)(consoleDumpEnd - consoleDumpSeq));
+            break;
+        case DUMP_TRACE_TIMELINE:
+            consoleDumpEnd = rtcTrace.head;
+            Serial.printf("-- timeline (%lu) --\n", (unsigned long)(consoleDumpEnd - consoleDumpSeq));
+            break;
+        default:
+            break;
+    }
+}
+
+void printConsoleDumpRecord(uint32_t seq) {
+    switch (consoleDump) {
+        case DUMP_METRICS_SEC:
+        case DUMP_METRICS_MIN: {
+            const MetricRing& ring = (consoleDump == DUMP_METRICS_SEC) ? metricsSec : metricsMin;
+            unsigned long stepSec = (consoleDump == DUMP_METRICS_SEC) ? 1 : 60;
+            const MetricSample& m = ring.samples[seq % ring.capacity];
+            unsigned long age = (unsigned long)(ring.pushed - seq) * stepSec;
+            Serial.printf("%lu,%u,%u,%u,%u,%u\n", age, m.heapKb, m.dutyPct, m.relays, m.loopMaxMs, m.thermalStep);
+            break;
+        }
+        case DUMP_TRACE_MILESTONES:
+            printTraceRecord(rtcTrace.milestones[seq & (RTC_MILESTONE_CAPACITY - 1)]);
+            break;
+        case DUMP_TRACE_TIMELINE:
+            printTraceRecord(rtcTrace.records[seq & (RTC_TRACE_CAPACITY - 1)]);
+            break;
+        default:
+            break;
+    }
+}
+
+void continueConsoleDump() {
+    for (int n = 0; n < CONSOLE_DUMP_LINES_PER_POLL && consoleDump != DUMP_NONE; n++) {
+        if (Serial.availableForWrite() < CONSOLE_DUMP_MIN_TX_ROOM) return;
+
+        if (consoleDumpSeq == consoleDumpEnd) {
+            switch (consoleDump) {
+                case DUMP_METRICS_SEC:      beginConsoleDump(DUMP_METRICS_MIN); break;
+                case DUMP_TRACE_MILESTONES: beginConsoleDump(DUMP_TRACE_TIMELINE); break;
+                case DUMP_METRICS_MIN:
+                    Serial.println("--- [END METRICS] ---");
+                    consoleDump = DUMP_NONE;
+                    break;
+                default:
+                    Serial.println("--- [END TRACE] ---");
+                    consoleDump = DUMP_NONE;
+                    break;
+            }
+            continue;
+        }
+
+        // Records overwritten while the dump was in progress are skipped
+        uint32_t oldest = consoleDumpOldest(consoleDump);
+        if ((int32_t)(consoleDumpSeq - oldest) < 0) {
+            Serial.printf("(%lu overwritten)\n", (unsigned long)(oldest - consoleDumpSeq));
+            consoleDumpSeq = oldest;
+            continue;
+        }
+        printConsoleDumpRecord(consoleDumpSeq++);
+    }
+}
+
+void consoleExecute(char* line) {
+    char* cmd = strtok(line, " \t");
+    if (!cmd) return;
+
+    if (consoleDump != DUMP_NONE) {
+        Serial.println("--- [DUMP ABORTED] ---");
+        consoleDump = DUMP_NONE;
+    }
+    char* arg1 = strtok(NULL, " \t");
+    char* arg2 = strtok(NULL, " \t");
+
+    if (strcmp(cmd, "help") == 0) {
+        Serial.println("stats | lat | stalls | pools | mem | metrics | trace | get | set <name> <value>");
+    } else if (strcmp(cmd, "stats") == 0) {
+        updateDisplayStats(millis());
+    } else if (strcmp(cmd, "lat") == 0) {
+        consolePrintLatency();
+    } else if (strcmp(cmd, "stalls") == 0) {
+        consolePrintStalls();
+    } else if (strcmp(cmd, "pools") == 0) {
+        consolePrintPools();
+    } else if (strcmp(cmd, "mem") == 0) {
+        consolePrintMemory();
+    } else if (strcmp(cmd, "metrics") == 0) {
+        beginConsoleDump(DUMP_METRICS_SEC);
+    } else if (strcmp(cmd, "trace") == 0) {
+        Serial.println("--- [RTC TRACE] current session ---");
+        beginConsoleDump(DUMP_TRACE_MILESTONES);
+    } else if (strcmp(cmd, "get") == 0) {
+        consolePrintTunables();
+    } else if (strcmp(cmd, "set") == 0) {
+        consoleSet(arg1, arg2);
+    } else {
+        Serial.printf("unknown command '%s' (try help)\n", cmd);
+    }
+}
+
+void pollConsole() {
+    if (!ENABLE_SERIAL_CONSOLE) return;
+
+    // 0. Continue any dump in progress
+    continueConsoleDump();
+
+    // 1. Drain a bounded number of UART bytes into the ring
+    for (int n = 0; n < CONSOLE_MAX_BYTES_PER_POLL && Serial.available(); n++) {
+        uint16_t next = (consoleRingHead + 1) & (CONSOLE_RX_RING_SIZE - 1);
+        if (next == consoleRingTail) break; // Ring full; leave the rest in the UART FIFO
+        consoleRing[consoleRingHead] = Serial.read();
+        consoleRingHead = next;
+    }
+
+    // 2. Assemble the line; stop after one complete command
+    while (consoleRingTail != consoleRingHead) {
+        char c = consoleRing[consoleRingTail];
+        consoleRingTail = (consoleRingTail + 1) & (CONSOLE_RX_RING_SIZE - 1);
+
+        if (c == '\r' || c == '\n') {
+            if (consoleLineOverflow) {
+                Serial.println("line too long");
+            } else if (consoleLineLen > 0) {
+                consoleLine[consoleLineLen] = '\0';
+                consoleExecute(consoleLine);
+            }
+            consoleLineLen = 0;
+            consoleLineOverflow = false;
+            return;
+        }
+        if (consoleLineLen < CONSOLE_LINE_MAX) consoleLine[consoleLineLen++] = c;
+        else consoleLineOverflow = true;
+    }
+}
 
 void setup() {
   Serial.begin(115200);
+  initRtcTrace();
   
-  ssidQueue = xQueueCreate(20, sizeof(SniffedSSID));
+  ssidQueue = xQueueCreate(SSID_QUEUE_LENGTH, sizeof(SniffedSSID));
   if (ENABLE_MESH_RELAY) {
-      meshQueue = xQueueCreate(5, sizeof(MeshPacket)); // Initialize Mesh Queue only if enabled
+      meshQueue = xQueueCreate(MESH_RX_QUEUE_LENGTH, sizeof(MeshPacket)); // Initialize Mesh Queue only if enabled
   }
 
   // --- GET LOCAL MAC ADDRESS FOR FILTERING ---
@@ -1062,13 +2662,14 @@ void setup() {
   if (ENABLE_PASSIVE_SCAN) {
     esp_wifi_set_promiscuous(true);
     // Start with the default sniffer for Probe Request learning
+    setPromiscFilter(SCAN_PROMISC_FILTER);
     esp_wifi_set_promiscuous_rx_cb(snifferCallback); 
   }
   
   esp_wifi_set_storage(WIFI_STORAGE_RAM);
   esp_wifi_set_mode(WIFI_MODE_STA);
   esp_wifi_start();
-  esp_wifi_set_max_tx_power(POWER_LEVELS[4]); 
+  setTxPower(POWER_LEVELS[4]); 
 
   initSwarm();
 }
@@ -1076,6 +2677,14 @@ void setup() {
 void loop() {
   unsigned long currentMillis = millis(); 
 
+  // A pass may also hold one mesh listen window, whose length is tunable
+  heartbeats[TASK_LOOP].expectedPeriodMs = LOOP_STALL_THRESHOLD_MS + tunables.meshCheckDurationMs;
+  checkHeartbeats(heartbeat(TASK_LOOP));
+
+  enterPhase(TASK_LOOP, PHASE_CONSOLE);
+  pollConsole();
+
+  enterPhase(TASK_LOOP, PHASE_SSID_INGEST);
   SniffedSSID s;
   while (xQueueReceive(ssidQueue, &s, 0) == pdTRUE) {
       String newSSID = String(s.ssid);
@@ -1095,7 +2704,7 @@ void loop() {
 
               if (activeSSIDs.size() < MAX_SSIDS_TO_LEARN + CYCLE_CAP_BUFFER) {
                   activeSSIDs.push_back(newSSID);
-                  learnedDataCount++;
+                  statInc(CTX_LOOP, STAT_LEARNED_SSIDS);
                   lastLearnedSSID = newSSID;
                   lastSsidLearnTime = currentMillis; 
               } 
@@ -1111,15 +2720,23 @@ void loop() {
       }
   }
 
+  enterPhase(TASK_LOOP, PHASE_RESOURCES);
   manageResources();
   manageMeshResources(currentMillis); // Prune old mesh messages and senders
+  updateHeapSoak(currentMillis);
+  updateBattery(currentMillis);
+  updateThermalGovernor(currentMillis);
+  updateMetricsHistory(currentMillis);
+  const PowerProfile& profile = activePowerProfile();
 
   if (currentMillis - lastLifecycleRun > nextLifecycleInterval) {
+      enterPhase(TASK_LOOP, PHASE_LIFECYCLE);
       lastLifecycleRun = currentMillis;
       // Using 66/100 (2/3) multiplier to meet the faster processing requirement 
       nextLifecycleInterval = random(MIN_LIFECYCLE_MS * 66 / 100, MAX_LIFECYCLE_MS * 66 / 100); 
       int rotateCount = random(3, 8);
       for(int i=0; i<rotateCount; i++) processLifecycle();
+      trace(TRACE_LIFECYCLE, rotateCount, activeSwarm.size());
   }
 
   // NEW: MESH DECAY TIMEOUT LOGIC
@@ -1128,6 +2745,7 @@ void loop() {
       currentMillis - lastMeshPacketTime > MESH_DECAY_TIMEOUT_MS) {
       
       isMeshDetected = false;
+      trace(TRACE_MESH_DECAY, 0, meshCache.size());
       meshCache.clear(); // Clear the cached packets on decay
   }
   
@@ -1138,16 +2756,19 @@ void loop() {
       // 2. Determine the interval based on state
       if (isMeshDetected) {
           // Mesh is active, use fast 300ms check
-          requiredInterval = MESH_ACTIVE_INTERVAL_MS;
+          requiredInterval = tunables.meshActiveIntervalMs;
       } else {
           // Mesh is not active/decayed, use slow 10-minute check
-          requiredInterval = MESH_STANDBY_INTERVAL_MS; 
+          requiredInterval = tunables.meshStandbyIntervalMs; 
       }
+      requiredInterval = requiredInterval * profile.meshIntervalScalePct / 100;
 
       // 3. Check if it's time to run the check
       if (currentMillis - lastMeshCheckTime > requiredInterval) {
           unsigned long meshCheckStart = millis();
+          enterPhase(TASK_LOOP, PHASE_MESH_CHECK);
           checkAndListenForMesh();
+          trace(TRACE_MESH_CHECK, isMeshDetected, meshCache.size());
           lastMeshCheckTime = currentMillis;
           activeTimeTotal += (millis() - meshCheckStart); 
       }
@@ -1157,8 +2778,9 @@ void loop() {
 
   if (currentMillis - lastChannelHop > nextChannelHopInterval) {
     unsigned long hopStart = millis(); // START TIMING ACTIVE BLOCK
+    enterPhase(TASK_LOOP, PHASE_HOP_TX);
     lastChannelHop = currentMillis;
-    nextChannelHopInterval = random(MIN_CHANNEL_HOP_MS, MAX_CHANNEL_HOP_MS);
+    nextChannelHopInterval = random(tunables.minChannelHopMs, tunables.maxChannelHopMs) * profile.hopDwellScalePct / 100;
     
     // --- HOPPING LOGIC ---
     if (HARDWARE_IS_C5) {
@@ -1184,7 +2806,16 @@ void loop() {
 
     esp_wifi_set_channel(currentChannel, WIFI_SECOND_CHAN_NONE);
 
-    int packetsThisHop = random(MIN_PACKETS_PER_HOP, MAX_PACKETS_PER_HOP);
+    int packetsThisHop = random(MIN_PACKETS_PER_HOP, MAX_PACKETS_PER_HOP) * profile.burstDutyScalePct / 100;
+    packetsThisHop = packetsThisHop * activeThermalStep().dutyScalePct / 100;
+
+    // Hops dominate the timeline; aggregate them so it spans minutes, not seconds
+    packetsSinceTrace += packetsThisHop;
+    if (++hopsSinceTrace >= TRACE_HOP_EVERY) {
+        trace(TRACE_HOP, currentChannel, packetsSinceTrace > 0xFFFF ? 0xFFFF : packetsSinceTrace);
+        hopsSinceTrace = 0;
+        packetsSinceTrace = 0;
+    }
 
     for (int i = 0; i < packetsThisHop; i++) {
         // --- MESH RELAY (MULTI-QUEUE) ---
@@ -1195,11 +2826,14 @@ void loop() {
             // Broadcast a cached mesh packet (randomly selected for diversity)
             int msgIdx = random(meshCache.size());
             const auto& msg = meshCache[msgIdx];
+            const uint8_t* frame = loadMeshFrame(msg);
 
-            esp_wifi_set_max_tx_power(MAX_TX_POWER); 
-            esp_wifi_80211_tx(WIFI_IF_STA, msg.payload.data(), msg.payload.size(), false);
-            meshRelayCount++;
-            totalPacketCount++;
+            if (frame) {
+                setTxPower(MAX_TX_POWER); 
+                esp_wifi_80211_tx(WIFI_IF_STA, frame, msg.rawLen, false);
+                statInc(CTX_LOOP, STAT_MESH_RELAYS);
+                statInc(CTX_LOOP, STAT_TOTAL_PACKETS);
+            }
         }
         // --- END MESH RELAY ---
         
@@ -1208,7 +2842,7 @@ void loop() {
             int swarmIdx = random(activeSwarm.size());
             VirtualDevice& vd = activeSwarm[swarmIdx];
             
-            esp_wifi_set_max_tx_power(vd.txPower);
+            setTxPower(vd.txPower);
 
             if (is5GHzBand && vd.generation == GEN_LEGACY) continue;
 
@@ -1235,18 +2869,18 @@ void loop() {
                      pktLen = buildEncryptedDataPacket(packetBuffer, vd);
                      esp_wifi_80211_tx(WIFI_IF_STA, packetBuffer, pktLen, false);
                      vd.sequenceNumber = (vd.sequenceNumber + 1) % 4096;
-                     totalPacketCount++;
-                     if (is5GHzBand) packets5G++; else packets2G++;
+                     statInc(CTX_LOOP, STAT_TOTAL_PACKETS);
+                     statIncBand(is5GHzBand);
                      fillSilenceWithNoise(random(5 * 75 / 100, 20 * 50 / 100));
                  }
-                 interactionCount++;
+                 statInc(CTX_LOOP, STAT_INTERACTIONS);
             }
             else {
                 pktLen = buildProbePacket(packetBuffer, vd, currentChannel);
                 esp_wifi_80211_tx(WIFI_IF_STA, packetBuffer, pktLen, false);
                 if (pktLen > 0) {
-                    totalPacketCount++;
-                    if (is5GHzBand) packets5G++; else packets2G++;
+                    statInc(CTX_LOOP, STAT_TOTAL_PACKETS);
+                    statIncBand(is5GHzBand);
                     
                     int step = (ENABLE_SEQUENCE_GAPS && random(100) < 20) ? random(2, 8) : 1;
                     vd.sequenceNumber = (vd.sequenceNumber + step) % 4096;
@@ -1265,13 +2899,13 @@ void loop() {
             String beaconSSID = activeSSIDs[ssidIdx];
             uint8_t mac[6]; 
             mac[0] = 0x02; mac[1] = 0x11; mac[2] = 0x22; 
-            mac[3] = random(255); mac[4] = random(255); mac[5] = random(255);
+            fillEntropy(&mac[3], 3);
             
-            esp_wifi_set_max_tx_power(MAX_TX_POWER); 
+            setTxPower(MAX_TX_POWER); 
             int pktLen = buildBeaconPacket(packetBuffer, mac, beaconSSID, currentChannel, random(4096));
             esp_wifi_80211_tx(WIFI_IF_STA, packetBuffer, pktLen, false);
-            totalPacketCount++;
-            if (is5GHzBand) packets5G++; else packets2G++;
+            statInc(CTX_LOOP, STAT_TOTAL_PACKETS);
+            statIncBand(is5GHzBand);
         }
 
         fillSilenceWithNoise(random(2 * 75 / 100, 10 * 50 / 100));
@@ -1283,8 +2917,12 @@ void loop() {
     activeTimeTotal += hopDuration; // END TIMING ACTIVE BLOCK
   }
   
-  if (currentMillis - lastUiUpdateTime > 2000) {
+  unsigned long uiRefreshMs = tunables.uiRefreshMs ? tunables.uiRefreshMs : profile.uiRefreshMs;
+  if (currentMillis - lastUiUpdateTime > uiRefreshMs) {
       lastUiUpdateTime = currentMillis;
+      enterPhase(TASK_LOOP, PHASE_DISPLAY);
       updateDisplayStats(currentMillis); 
   }
+
+  recordLoopLatency(millis() - currentMillis);
 }
@@ -0,0 +1,281 @@
+/*
+ * Ghost Walk host build support (GHOSTWALK_HOST_SOAK).
+ * Stands in for the Arduino core, esp_wifi, FreeRTOS and the ESP heap so the
+ * dual-band sketch runs on a PC as a headless C5 on a virtual clock:
+ *   - millis()/micros() only move when the sketch waits (delay, yield) or
+ *     transmits (esp_wifi_80211_tx costs HOST_TX_AIRTIME_US)
+ *   - every allocation goes through a counting operator new, and
+ *     ESP.getFreeHeap() reports HOST_HEAP_BYTES minus what is live
+ *   - the installed promiscuous callback is fed synthetic frames by
+ *     hostDeliverTraffic() (defined by the harness) as virtual time passes
+ * The heap model has no fragmentation: getMaxAllocHeap() == getFreeHeap().
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <string>
+#include <new>
+
+// --- HOST MODEL PARAMETERS ---
+const uint32_t HOST_HEAP_BYTES = 240 * 1024;    // Typical free heap once WiFi is up
+const uint32_t HOST_TX_AIRTIME_US = 500;        // Virtual cost of one esp_wifi_80211_tx
+const uint32_t HOST_YIELD_US = 100;             // Virtual cost of yield()
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+// --- VIRTUAL CLOCK ---
+uint64_t hostNowUs = 0;
+void hostDeliverTraffic(uint64_t nowUs);   // Provided by the harness
+
+void hostAdvanceUs(uint64_t us) {
+    uint64_t target = hostNowUs + us;
+    // Step in 1 ms slices so traffic lands inside listen windows
+    while (hostNowUs < target) {
+        uint64_t step = target - hostNowUs;
+        if (step > 1000) step = 1000;
+        hostNowUs += step;
+        hostDeliverTraffic(hostNowUs);
+    }
+}
+
+unsigned long millis() { return (unsigned long)(hostNowUs / 1000); }
+unsigned long micros() { return (unsigned long)hostNowUs; }
+void delay(unsigned long ms) { hostAdvanceUs((uint64_t)ms * 1000); }
+void yield() { hostAdvanceUs(HOST_YIELD_US); }
+
+// --- COUNTING HEAP ---
+size_t hostHeapLive = 0;
+size_t hostHeapMinFree = HOST_HEAP_BYTES;
+const size_t HOST_ALLOC_HEADER = 16;   // Keeps returned blocks 16-byte aligned
+
+void* operator new(size_t size) {
+    unsigned char* p = (unsigned char*)malloc(size + HOST_ALLOC_HEADER);
+    if (!p) throw std::bad_alloc();
+    memcpy(p, &size, sizeof(size));
+    hostHeapLive += size;
+    if (hostHeapLive < HOST_HEAP_BYTES && HOST_HEAP_BYTES - hostHeapLive < hostHeapMinFree) {
+        hostHeapMinFree = HOST_HEAP_BYTES - hostHeapLive;
+    }
+    return p + HOST_ALLOC_HEADER;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    unsigned char* p = (unsigned char*)ptr - HOST_ALLOC_HEADER;
+    size_t size;
+    memcpy(&size, p, sizeof(size));
+    hostHeapLive -= size;
+    free(p);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+
+struct EspClass {
+    uint32_t getFreeHeap() { return hostHeapLive < HOST_HEAP_BYTES ? HOST_HEAP_BYTES - hostHeapLive : 0; }
+    uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+    uint32_t getMinFreeHeap() { return hostHeapMinFree; }
+};
+EspClass ESP;
+
+// --- ARDUINO CORE ---
+class String : public std::string {
+public:
+    String() {}
+    String(const char* s) : std::string(s) {}
+    String(const std::string& s) : std::string(s) {}
+    String(int v) : std::string(std::to_string(v)) {}
+    bool equals(const String& o) const { return *this == o; }
+    String substring(size_t from, size_t to) const { return std::string::substr(from, to - from); }
+};
+inline String operator+(const String& a, const char* b) { return String(std::string(a) + b); }
+
+// Deterministic PRNG (xorshift32) so a soak run is reproducible from its seed
+uint32_t hostRngState = 0x9E3779B9;
+uint32_t hostRandom32() {
+    hostRngState ^= hostRngState << 13;
+    hostRngState ^= hostRngState >> 17;
+    hostRngState ^= hostRngState << 5;
+    return hostRngState;
+}
+long random(long howbig) { return howbig > 0 ? (long)(hostRandom32() % (uint32_t)howbig) : 0; }
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long) {}   // Seeded by the harness instead
+
+int analogRead(int) { return 0; }
+uint32_t analogReadMilliVolts(int) { return 4000; }
+float temperatureRead() { return 45.0f; }
+void pinMode(int, int) {}
+
+// Serial: stdout only when hostSerialEcho is set, except [SOAK] lines
+bool hostSerialEcho = false;
+
+struct HardwareSerial {
+    void emit(const char* s) {
+        if (hostSerialEcho || strstr(s, "[SOAK]")) fputs(s, stdout);
+    }
+    void begin(int) {}
+    void print(const char* s) { emit(s); }
+    void println(const char* s = "") { emit(s); emit("\n"); }
+    void println(const String& s) { println(s.c_str()); }
+    void printf(const char* fmt, ...) {
+        char buf[512];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        emit(buf);
+    }
+    int available() { return 0; }
+    int availableForWrite() { return 128; }
+    int read() { return -1; }
+};
+HardwareSerial Serial;
+
+// --- ESP-IDF SYSTEM ---
+typedef enum {
+    ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO
+} esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+
+uint32_t esp_random() { return hostRandom32(); }
+void esp_fill_random(void* buf, size_t len) {
+    uint8_t* p = (uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) p[i] = (uint8_t)hostRandom32();
+}
+
+typedef enum { ESP_MAC_WIFI_STA } esp_mac_type_t;
+int esp_read_mac(uint8_t* mac, esp_mac_type_t) {
+    const uint8_t hostMac[6] = {0x24, 0x6F, 0x28, 0x00, 0x50, 0x0C};
+    memcpy(mac, hostMac, 6);
+    return 0;
+}
+
+// --- ESP-IDF WIFI ---
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum { WIFI_PKT_MGMT, WIFI_PKT_CTRL, WIFI_PKT_DATA, WIFI_PKT_MISC } wifi_promiscuous_pkt_type_t;
+typedef struct { unsigned sig_len:12; signed rssi:8; } wifi_pkt_rx_ctrl_t;
+typedef struct { wifi_pkt_rx_ctrl_t rx_ctrl; uint8_t payload[0]; } wifi_promiscuous_pkt_t;
+typedef struct { uint32_t filter_mask; } wifi_promiscuous_filter_t;
+#define WIFI_PROMIS_FILTER_MASK_ALL 0xFFFFFFFF
+#define WIFI_PROMIS_FILTER_MASK_MGMT (1 << 0)
+#define WIFI_PROMIS_FILTER_MASK_CTRL (1 << 1)
+#define WIFI_PROMIS_FILTER_MASK_DATA (1 << 2)
+#define WIFI_PROMIS_FILTER_MASK_MISC (1 << 3)
+
+typedef struct { int unused; } wifi_init_config_t;
+#define WIFI_INIT_CONFIG_DEFAULT() {0}
+typedef enum { WIFI_IF_STA } wifi_interface_t;
+typedef enum { WIFI_SECOND_CHAN_NONE } wifi_second_chan_t;
+typedef enum { WIFI_STORAGE_RAM } wifi_storage_t;
+typedef enum { WIFI_MODE_STA } wifi_mode_t;
+typedef void (*wifi_promiscuous_cb_t)(void*, wifi_promiscuous_pkt_type_t);
+
+wifi_promiscuous_cb_t hostRxCallback = NULL;
+uint32_t hostFilterMask = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_CTRL | WIFI_PROMIS_FILTER_MASK_DATA;
+uint8_t hostChannel = 1;
+uint64_t hostFramesSent = 0;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t*) { return ESP_OK; }
+esp_err_t esp_wifi_set_storage(wifi_storage_t) { return ESP_OK; }
+esp_err_t esp_wifi_set_mode(wifi_mode_t) { return ESP_OK; }
+esp_err_t esp_wifi_start() { return ESP_OK; }
+esp_err_t esp_wifi_set_max_tx_power(int8_t) { return ESP_OK; }
+esp_err_t esp_wifi_set_promiscuous(bool) { return ESP_OK; }
+esp_err_t esp_wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb) { hostRxCallback = cb; return ESP_OK; }
+esp_err_t esp_wifi_set_promiscuous_filter(const wifi_promiscuous_filter_t* f) { hostFilterMask = f->filter_mask; return ESP_OK; }
+esp_err_t esp_wifi_get_promiscuous_filter(wifi_promiscuous_filter_t* f) { f->filter_mask = hostFilterMask; return ESP_OK; }
+esp_err_t esp_wifi_set_channel(uint8_t channel, wifi_second_chan_t) { hostChannel = channel; return ESP_OK; }
+esp_err_t esp_wifi_80211_tx(wifi_interface_t, const void*, int, bool) {
+    hostFramesSent++;
+    hostAdvanceUs(HOST_TX_AIRTIME_US);
+    return ESP_OK;
+}
+
+// Hands one synthetic frame to the installed callback, honouring the type filter
+void hostReceiveFrame(wifi_promiscuous_pkt_type_t type, const uint8_t* frame, int len) {
+    if (!hostRxCallback || !(hostFilterMask & (1u << type))) return;
+    static uint8_t rxBuf[sizeof(wifi_promiscuous_pkt_t) + 1024];
+    wifi_promiscuous_pkt_t* pkt = (wifi_promiscuous_pkt_t*)rxBuf;
+    memset(&pkt->rx_ctrl, 0, sizeof(pkt->rx_ctrl));
+    pkt->rx_ctrl.sig_len = len;
+    pkt->rx_ctrl.rssi = -60;
+    memcpy(pkt->payload, frame, len);
+    hostRxCallback(pkt, type);
+}
+
+#define WIFI_STA 1
+struct WiFiClass {
+    void mode(int) {}
+    void disconnect() {}
+};
+WiFiClass WiFi;
+
+// --- FREERTOS ---
+typedef int BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdMS_TO_TICKS(x) (x)
+#define portMAX_DELAY 0xFFFFFFFF
+
+struct HostQueue {
+    uint8_t* storage;
+    int length;
+    int itemSize;
+    int head;
+    int count;
+};
+typedef HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(int length, int itemSize) {
+    HostQueue* q = new HostQueue;
+    q->storage = new uint8_t[length * itemSize];
+    q->length = length;
+    q->itemSize = itemSize;
+    q->head = 0;
+    q->count = 0;
+    return q;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t*) {
+    if (q->count == q->length) return pdFALSE;
+    int slot = (q->head + q->count) % q->length;
+    memcpy(q->storage + slot * q->itemSize, item, q->itemSize);
+    q->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t) {
+    if (q->count == 0) return pdFALSE;
+    memcpy(item, q->storage + q->head * q->itemSize, q->itemSize);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) { return q->count; }
+
+// Single-threaded host: tasks are not started, mutexes always succeed
+typedef void* SemaphoreHandle_t;
+SemaphoreHandle_t xSemaphoreCreateMutex() { return (SemaphoreHandle_t)1; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+BaseType_t xTaskCreatePinnedToCore(void (*)(void*), const char*, uint32_t, void*, UBaseType_t, TaskHandle_t*, BaseType_t) {
+    return pdPASS;
+}
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
@@ -0,0 +1,126 @@
+/*
+ * Ghost Walk heap soak harness (host build).
+ *
+ * Runs the dual-band sketch's setup()/loop() on a virtual clock with
+ * synthetic probe requests and ESP-NOW style mesh frames, so 72+ hours of
+ * firmware time take minutes. The sketch's heap soak monitor judges each
+ * window; the process exits non-zero if any window drifted.
+ *
+ * Build:  g++ -std=gnu++17 -O2 -o soak host/soak.cpp
+ * Run:    ./soak [hours (default 72)] [seed (default 1)] [-v]
+ *         -v echoes the sketch's Serial output; [SOAK] lines always print.
+ * Exit:   0 = all windows PASS, 1 = drift FAIL, 2 = too short for a verdict
+ */
+#define GHOSTWALK_HOST_SOAK
+#include "../ghostwalk5ghz.cpp"
+
+// --- SYNTHETIC TRAFFIC ---
+const int HOST_PROBE_EVERY_MS = 20;       // ~50 probe requests/s around the unit
+const int HOST_MESH_EVERY_MS = 25;        // ~40 mesh frames/s on the mesh channel
+const int HOST_SSID_POOL = 600;           // Distinct SSIDs phones ask for
+const int HOST_MESH_SENDERS = 12;
+const int HOST_MESH_MESSAGES = 200;       // Distinct mesh payloads (repeats exercise dedupe)
+
+uint64_t hostLastTrafficMs = 0;
+uint64_t hostProbesDelivered = 0;
+uint64_t hostMeshDelivered = 0;
+
+// Skewed pick: low indices (popular SSIDs / chatty messages) come up more often
+int hostSkewedPick(int range) {
+    uint32_t a = hostRandom32() % range;
+    uint32_t b = hostRandom32() % range;
+    return (int)(a * b / range);
+}
+
+void hostSendProbe() {
+    uint8_t frame[64];
+    memset(frame, 0, sizeof(frame));
+    frame[0] = 0x40;                                     // Probe Request
+    memset(&frame[4], 0xFF, 6);
+    frame[10] = 0x02;                                    // Randomized client MAC
+    esp_fill_random(&frame[11], 5);
+    memset(&frame[16], 0xFF, 6);
+
+    // Lengths 6..29 so both inline and heap-backed Strings get exercised
+    int id = hostSkewedPick(HOST_SSID_POOL);
+    char ssid[32];
+    int len = snprintf(ssid, sizeof(ssid), "Net-%d-%.*s", id, id % 24, "abcdefghijklmnopqrstuvwx");
+    frame[24] = 0x00;
+    frame[25] = len;
+    memcpy(&frame[26], ssid, len);
+    hostReceiveFrame(WIFI_PKT_MGMT, frame, 26 + len);
+    hostProbesDelivered++;
+}
+
+void hostSendMesh() {
+    uint8_t frame[512];
+    int msg = hostSkewedPick(HOST_MESH_MESSAGES);
+    int sender = msg % HOST_MESH_SENDERS;
+    int len = 60 + (msg * 37) % 340;
+
+    memset(frame, 0, 24);
+    frame[0] = 0xD0;                                     // Action frame (ESP-NOW)
+    memset(&frame[4], 0xFF, 6);
+    const uint8_t senderMac[6] = {0x02, 0xE5, 0x70, 0x00, 0x00, (uint8_t)sender};
+    memcpy(&frame[10], senderMac, 6);
+    memset(&frame[16], 0xFF, 6);
+
+    // Text-like body, deterministic per message so repeats compare equal
+    int pos = 24;
+    pos += snprintf((char*)&frame[pos], len - pos, "MSG %d from node %d: ", msg, sender);
+    while (pos < len) {
+        frame[pos] = "the quick brown fox status ok "[(pos + msg) % 30];
+        pos++;
+    }
+    hostReceiveFrame(WIFI_PKT_MGMT, frame, len);
+    hostMeshDelivered++;
+}
+
+// Called by the virtual clock once per elapsed millisecond
+void hostDeliverTraffic(uint64_t nowUs) {
+    uint64_t nowMs = nowUs / 1000;
+    while (hostLastTrafficMs < nowMs) {
+        hostLastTrafficMs++;
+        if (hostRandom32() % HOST_PROBE_EVERY_MS == 0) hostSendProbe();
+        if (hostChannel == MESH_CHANNEL && hostRandom32() % HOST_MESH_EVERY_MS == 0) hostSendMesh();
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long hours = 72;
+    uint32_t seed = 1;
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) hostSerialEcho = true;
+        else if (positional++ == 0) hours = strtoul(argv[i], NULL, 10);
+        else seed = strtoul(argv[i], NULL, 10);
+    }
+    hostRngState = seed ? seed : 1;
+
+    setup();
+
+    uint64_t endUs = (uint64_t)hours * 3600ULL * 1000000ULL;
+    uint64_t loopPasses = 0;
+    while (hostNowUs < endUs) {
+        uint64_t before = hostNowUs;
+        loop();
+        loopPasses++;
+        if (hostNowUs == before) hostAdvanceUs(1000);   // Idle pass
+    }
+
+    printf("soak: %lu h virtual, %llu loop passes, %llu frames sent, %llu probes / %llu mesh frames received\n",
+           hours, (unsigned long long)loopPasses, (unsigned long long)hostFramesSent,
+           (unsigned long long)hostProbesDelivered, (unsigned long long)hostMeshDelivered);
+    printf("soak: %lu windows, baseline min free %lu B, free now %lu B, lowest %lu B, low-mem trips %lu\n",
+           (unsigned long)heapSoak.windowIndex, (unsigned long)heapSoak.baselineFree,
+           (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(),
+           (unsigned long)heapSoak.lowMemTransitions);
+
+    // Window 0 only sets the baseline; a verdict needs at least one more
+    if (heapSoak.windowIndex < 2) {
+        printf("soak: INCONCLUSIVE (run longer than warm-up + 2 windows)\n");
+        return 2;
+    }
+    printf("soak: %s\n", heapSoak.drifting ? "FAIL (heap drift)" : "PASS");
+    return heapSoak.drifting ? 1 : 0;
+}